@@ -0,0 +1,222 @@
+/* Copyright (c) 2018 Cameron Harper
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * */
+
+#ifndef CORO_H
+#define CORO_H
+
+/** @file */
+
+/**
+ * @defgroup coro
+ * 
+ * Stackless coroutines (protothreads)
+ * 
+ * A coroutine is a function that can suspend part way through and 
+ * resume at the same point the next time it is called. The resume
+ * point is kept in a switch statement on __LINE__, so the state of 
+ * a coroutine is a few bytes instead of a stack.
+ * 
+ * A coroutine suspends on a wait condition (FIFO level, semaphore 
+ * or timer deadline). The condition is recorded in the coroutine 
+ * state and checked by coro_poll(), which only resumes coroutines 
+ * whose condition has become true.
+ * 
+ * @code
+ * static struct coro rx;
+ * 
+ * static void rx_task(struct coro *self)
+ * {
+ *     CORO_BEGIN(self);
+ *     
+ *     for(;;){
+ *         
+ *         CORO_AWAIT_FIFO(self, &rx_fifo, 4U);
+ *         // read a 4 byte header
+ *         
+ *         CORO_AWAIT_TICKS(self, 2U);
+ *         // and so on
+ *     }
+ *     
+ *     CORO_END(self);
+ * }
+ * 
+ * // in main
+ * coro_start(&rx, rx_task);
+ * for(;;){ coro_poll(); }
+ * @endcode
+ * 
+ * @warning local variables are not kept across a wait, keep them in static storage or in a structure that contains struct coro
+ * @warning do not use switch statements that span a wait
+ * 
+ * @{
+ * */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "fifo.h"
+#include "semaphore.h"
+#include "timer.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/** what a coroutine is waiting for */
+enum coro_wait {
+    CORO_WAIT_NONE,         /**< ready to run */
+    CORO_WAIT_FIFO,         /**< FIFO has at least n bytes */
+    CORO_WAIT_SEMAPHORE,    /**< semaphore signalled */
+    CORO_WAIT_TICKS,        /**< timer deadline passed */
+    CORO_WAIT_DONE          /**< coroutine has ended */
+};
+
+struct coro;
+
+/** coroutine function */
+typedef void (*coro_fn)(struct coro *self);
+
+/** 
+ * coroutine state
+ * 
+ * */
+struct coro {
+    
+    struct coro *next;
+    coro_fn fn;
+    uint16_t line;                  /**< resume point (0 to start) */
+    enum coro_wait wait;
+    uint8_t n;                      /**< FIFO level */
+    volatile void *object;          /**< FIFO or semaphore */
+    uint32_t deadline;              /**< timer ticks */
+};
+
+/** start of the coroutine body */
+#define CORO_BEGIN(self) switch((self)->line){ case 0U:
+
+/** end of the coroutine body (the coroutine is removed from coro_poll()) */
+#define CORO_END(self) } (self)->line = 0U; (self)->wait = CORO_WAIT_DONE; return;
+
+/* suspend with a wait condition and resume here */
+#define CORO_SUSPEND(self, WAIT) \
+    (self)->wait = (WAIT); \
+    (self)->line = __LINE__; \
+    return; \
+    case __LINE__:;
+
+/** suspend and resume on the next coro_poll() */
+#define CORO_YIELD(self) do{ CORO_SUSPEND((self), CORO_WAIT_NONE) }while(0)
+
+/** end the coroutine here */
+#define CORO_EXIT(self) do{ (self)->line = 0U; (self)->wait = CORO_WAIT_DONE; return; }while(0)
+
+/** 
+ * wait until a FIFO holds at least N bytes
+ * 
+ * @param[in] self
+ * @param[in] FIFO pointer to struct fifo
+ * @param[in] N number of bytes (1 to 255)
+ * 
+ * */
+#define CORO_AWAIT_FIFO(self, FIFO, N) do{ \
+    if(fifo_size(FIFO) < (N)){ \
+        (self)->object = (FIFO); \
+        (self)->n = (N); \
+        CORO_SUSPEND((self), CORO_WAIT_FIFO) \
+    } \
+}while(0)
+
+/** 
+ * wait on a semaphore 
+ * 
+ * One signal is consumed, as with semaphore_wait().
+ * 
+ * @param[in] self
+ * @param[in] SEM pointer to struct semaphore
+ * 
+ * */
+#define CORO_AWAIT_SEMAPHORE(self, SEM) do{ \
+    if(!semaphore_wait(SEM)){ \
+        (self)->object = (SEM); \
+        CORO_SUSPEND((self), CORO_WAIT_SEMAPHORE) \
+    } \
+}while(0)
+
+/** 
+ * wait for a number of timer ticks 
+ * 
+ * @param[in] self
+ * @param[in] TICKS timer ticks
+ * 
+ * */
+#define CORO_AWAIT_TICKS(self, TICKS) do{ \
+    (self)->deadline = timer_get_time() + (TICKS); \
+    CORO_SUSPEND((self), CORO_WAIT_TICKS) \
+}while(0)
+
+/**
+ * Start a coroutine
+ * 
+ * The coroutine is added to those resumed by coro_poll() and runs 
+ * from the beginning the next time it is polled.
+ * 
+ * @param[in] self  pointer to app managed state
+ * @param[in] fn    coroutine
+ * 
+ * */
+void coro_start(struct coro *self, coro_fn fn);
+
+/**
+ * Stop a coroutine
+ * 
+ * @param[in] self  pointer to app managed state
+ * 
+ * */
+void coro_stop(struct coro *self);
+
+/**
+ * Has a coroutine ended or been stopped?
+ * 
+ * @param[in] self  pointer to app managed state
+ * 
+ * @retval true
+ * @retval false
+ * 
+ * */
+bool coro_done(const struct coro *self);
+
+/**
+ * Resume every coroutine whose wait condition is true
+ * 
+ * Call from the mainloop.
+ * 
+ * @retval true at least one coroutine was resumed
+ * @retval false
+ * 
+ * */
+bool coro_poll(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+/** @} */
+#endif
@@ -0,0 +1,104 @@
+/* Copyright (c) 2018 Cameron Harper
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * */
+
+#ifndef COUNTER_H
+#define COUNTER_H
+
+/** @file */
+
+/**
+ * @defgroup counter
+ * 
+ * Free running high resolution counter using TC1
+ * 
+ * TC1 runs in normal mode from the io clock and overflows are counted
+ * to extend it to 32 bits. Other modules use this as a time base for
+ * timestamps.
+ * 
+ * @{
+ * */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+/** TC1 prescaler (values match CS12:0) */
+enum counter_prescaler {
+    COUNTER_DIV_1 = 1U,
+    COUNTER_DIV_8,
+    COUNTER_DIV_64,
+    COUNTER_DIV_256,
+    COUNTER_DIV_1024
+};
+
+/**
+ * Start the counter from zero
+ * 
+ * @param[in] div io clock prescaler
+ * 
+ * */
+void counter_start(enum counter_prescaler div);
+
+/**
+ * Stop the counter
+ * 
+ * */
+void counter_stop(void);
+
+/**
+ * Current value of the extended counter
+ * 
+ * @return counter ticks
+ * 
+ * */
+uint32_t counter_get_time(void);
+
+/**
+ * Extend a 16 bit TC1 reading to 32 bits
+ * 
+ * For use in interrupt handlers that have captured TCNT1 or ICR1. 
+ * An overflow that happened after the value was captured but has 
+ * not been serviced is accounted for.
+ * 
+ * @warning call with interrupts disabled and within half a TC1 period of capture
+ * 
+ * @param[in] value TC1 value
+ * @return counter ticks
+ * 
+ * */
+uint32_t counter_extend(uint16_t value);
+
+/**
+ * Counter ticks per second at the current system clock prescaler
+ * 
+ * @return ticks per second
+ * 
+ * */
+uint32_t counter_ticks_per_second(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+/** @} */
+#endif
@@ -0,0 +1,147 @@
+/* Copyright (c) 2018 Cameron Harper
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * */
+
+#ifndef DEBOUNCE_H
+#define DEBOUNCE_H
+
+/** @file */
+
+/**
+ * @defgroup debounce
+ * 
+ * Periodic sampling input debouncer
+ * 
+ * Whole ports are sampled at once and debounced with a 2 bit vertical
+ * counter per pin, so every pin on a port is debounced by the same
+ * few instructions. A pin must be sampled in its new state four 
+ * times in a row before a press or release event is queued.
+ * 
+ * Sampling is driven either by calling debounce_sample() from a 
+ * periodic interrupt (5-10ms is typical) or by the timer module
+ * via debounce_start().
+ * 
+ * @{
+ * */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "pin.h"
+
+#ifndef DEBOUNCE_EVENT_SIZE
+/** number of events that can be queued */
+#   define DEBOUNCE_EVENT_SIZE 8U
+#endif
+
+/** debounced input event */
+struct debounce_event {
+    
+    enum pin_id id;
+    bool pressed;       /**< true if pressed, false if released */
+};
+
+/**
+ * Add a pin to the debouncer
+ * 
+ * The pin is configured as an input (with pullup if active low).
+ * Its present state is taken as the initial debounced state.
+ * 
+ * @param[in] id
+ * @param[in] active_low    true if the pin reads low when pressed
+ * 
+ * */
+void debounce_add(enum pin_id id, bool active_low);
+
+/**
+ * Remove a pin from the debouncer
+ * 
+ * @param[in] id
+ * 
+ * */
+void debounce_remove(enum pin_id id);
+
+/**
+ * Sample every debounced pin
+ * 
+ * Call this at a fixed rate from an interrupt or the mainloop.
+ * 
+ * */
+void debounce_sample(void);
+
+/**
+ * Sample from a timer event
+ * 
+ * @note the timer module resolution is 1/TIMER_TICKS_PER_SECOND
+ * 
+ * @param[in] interval  timer ticks between samples
+ * 
+ * */
+void debounce_start(uint32_t interval);
+
+/**
+ * Stop sampling from a timer event
+ * 
+ * */
+void debounce_stop(void);
+
+/**
+ * Get the oldest event
+ * 
+ * @param[out] ev
+ * 
+ * @retval true
+ * @retval false no events
+ * 
+ * */
+bool debounce_get_event(struct debounce_event *ev);
+
+/**
+ * Were events dropped because the event FIFO was full?
+ * 
+ * The condition is cleared by calling this function.
+ * 
+ * @retval true one or more events were dropped
+ * @retval false
+ * 
+ * */
+bool debounce_event_lost(void);
+
+/**
+ * Get the debounced state of a pin
+ * 
+ * @param[in] id
+ * 
+ * @retval true pressed
+ * @retval false released (or not debounced)
+ * 
+ * */
+bool debounce_is_pressed(enum pin_id id);
+
+#ifdef __cplusplus
+}
+#endif
+
+/** @} */
+#endif
@@ -0,0 +1,152 @@
+/* Copyright (c) 2018 Cameron Harper
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * */
+
+#ifndef EVENT_H
+#define EVENT_H
+
+/** @file */
+
+/**
+ * @defgroup event
+ * 
+ * Event flag groups
+ * 
+ * A group holds 8 (or 16 with EVENT_WIDE) independent flags. Flags 
+ * are raised from interrupts and tested and cleared by the mainloop
+ * as a set, so many conditions can be checked with one critical 
+ * section instead of one semaphore each.
+ * 
+ * @{
+ * */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef EVENT_WIDE
+/** flag mask */
+typedef uint16_t event_flags_t;
+#else
+/** flag mask */
+typedef uint8_t event_flags_t;
+#endif
+
+/** event group state */
+struct event_group {
+    
+    volatile event_flags_t flags;
+};
+
+/**
+ * Initialise an event group with all flags clear
+ * 
+ * @param[in] self
+ * 
+ * */
+void event_init(struct event_group *self);
+
+/**
+ * Raise flags
+ * 
+ * Safe to call from interrupts.
+ * 
+ * @param[in] self
+ * @param[in] mask  flags to raise
+ * 
+ * */
+void event_set(struct event_group *self, event_flags_t mask);
+
+/**
+ * Clear flags without testing them
+ * 
+ * @param[in] self
+ * @param[in] mask  flags to clear
+ * 
+ * */
+void event_clear(struct event_group *self, event_flags_t mask);
+
+/**
+ * Read flags without affecting the state
+ * 
+ * @param[in] self
+ * @return raised flags
+ * 
+ * */
+event_flags_t event_peek(struct event_group *self);
+
+/**
+ * Test and clear any of the flags in mask
+ * 
+ * @param[in] self
+ * @param[in] mask  flags of interest
+ * @return flags in mask that were raised (and are now cleared)
+ * 
+ * */
+event_flags_t event_wait_any(struct event_group *self, event_flags_t mask);
+
+/**
+ * Test and clear all of the flags in mask
+ * 
+ * Flags are only cleared if all of them are raised.
+ * 
+ * @param[in] self
+ * @param[in] mask  flags of interest
+ * @retval true all flags in mask were raised (and are now cleared)
+ * @retval false
+ * 
+ * */
+bool event_wait_all(struct event_group *self, event_flags_t mask);
+
+/**
+ * Sleep until any of the flags in mask are raised, then clear them
+ * 
+ * Sleeps in the mode selected by set_sleep_mode(). The interrupt that 
+ * raises a flag must be able to wake the device from that mode.
+ * 
+ * Call with interrupts enabled, they are enabled on return.
+ * 
+ * @param[in] self
+ * @param[in] mask  flags of interest (must be non-zero)
+ * @return flags in mask that were raised (and are now cleared)
+ * 
+ * */
+event_flags_t event_sleep_any(struct event_group *self, event_flags_t mask);
+
+/**
+ * Sleep until all of the flags in mask are raised, then clear them
+ * 
+ * @see event_sleep_any()
+ * 
+ * @param[in] self
+ * @param[in] mask  flags of interest
+ * 
+ * */
+void event_sleep_all(struct event_group *self, event_flags_t mask);
+
+#ifdef __cplusplus
+}
+#endif
+
+/** @} */
+#endif
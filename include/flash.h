@@ -0,0 +1,212 @@
+/* Copyright (c) 2018 Cameron Harper
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * */
+
+#ifndef FLASH_H
+#define FLASH_H
+
+/** @file */
+
+/**
+ * @defgroup flash
+ * 
+ * SPI NOR flash driver with streaming reads and a write-behind page cache
+ * 
+ * Appended bytes are collected in a RAM copy of the current page and
+ * programmed one page at a time. Program and erase operations do not
+ * block; the busy flag is polled from the mainloop at intervals set
+ * by a timer.
+ * 
+ * Requires:
+ * 
+ * - spi_init() in mode 0 or 3 with MSB first order
+ * - timer_start()
+ * - flash_process() to be called from the mainloop
+ * 
+ * @warning do not use from an interrupt context
+ * 
+ * @{
+ * */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "pin.h"
+#include "fifo.h"
+
+/** size of a program page in bytes */
+#define FLASH_PAGE_SIZE 256U
+
+/** size of an erase sector in bytes */
+#define FLASH_SECTOR_SIZE 4096UL
+
+#ifndef FLASH_POLL_INTERVAL
+/** timer ticks between busy polls */
+#   define FLASH_POLL_INTERVAL 1U
+#endif
+
+/**
+ * Initialise flash driver
+ * 
+ * @param[in] cs    chip select pin
+ * 
+ * */
+void flash_init(enum pin_id cs);
+
+/**
+ * Perform outstanding work
+ * 
+ * Checks the busy flag when a poll is due and programs the page
+ * cache once the flash is idle.
+ * 
+ * */
+void flash_process(void);
+
+/**
+ * Is the flash busy?
+ * 
+ * @retval true program or erase in progress, or cached data waiting to be programmed
+ * @retval false
+ * 
+ * */
+bool flash_busy(void);
+
+/**
+ * Read the JEDEC manufacturer and device ID
+ * 
+ * @param[out] id   3 bytes
+ * 
+ * @retval true
+ * @retval false flash is busy
+ * 
+ * */
+bool flash_read_id(uint8_t *id);
+
+/**
+ * Fast read into a buffer
+ * 
+ * @param[in] addr
+ * @param[out] buf
+ * @param[in] len
+ * 
+ * @retval true
+ * @retval false flash is busy
+ * 
+ * */
+bool flash_read(uint32_t addr, void *buf, size_t len);
+
+/**
+ * Open a continuous fast read
+ * 
+ * The flash remains selected until flash_stream_close() so that
+ * consecutive reads continue from where the last one stopped.
+ * 
+ * @note cached bytes that have not been programmed are not visible
+ * 
+ * @param[in] addr
+ * 
+ * @retval true
+ * @retval false flash is busy
+ * 
+ * */
+bool flash_stream_open(uint32_t addr);
+
+/**
+ * Read from an open stream into a buffer
+ * 
+ * @param[out] buf
+ * @param[in] len
+ * 
+ * */
+void flash_stream_read(void *buf, size_t len);
+
+/**
+ * Read from an open stream into a FIFO
+ * 
+ * Reading stops when the FIFO becomes full.
+ * 
+ * @param[in] fifo
+ * @param[in] len   maximum number of bytes to read
+ * @return number of bytes read
+ * 
+ * */
+size_t flash_stream_read_fifo(volatile struct fifo *fifo, size_t len);
+
+/**
+ * Close an open stream
+ * 
+ * */
+void flash_stream_close(void);
+
+/**
+ * Set the address of the next appended byte
+ * 
+ * @param[in] addr
+ * 
+ * @retval true
+ * @retval false page cache holds data that has not been programmed
+ * 
+ * */
+bool flash_seek(uint32_t addr);
+
+/**
+ * Append bytes
+ * 
+ * Bytes are copied into the page cache and the cache is programmed
+ * when full. Fewer than len bytes are accepted when a full cache is
+ * still waiting for the flash to become idle.
+ * 
+ * @note the destination must have been erased
+ * 
+ * @param[in] data
+ * @param[in] len
+ * @return number of bytes accepted
+ * 
+ * */
+size_t flash_append(const void *data, size_t len);
+
+/**
+ * Program the partially filled page cache as soon as the flash is idle
+ * 
+ * */
+void flash_flush(void);
+
+/**
+ * Erase the sector containing an address
+ * 
+ * @param[in] addr
+ * 
+ * @retval true erase started
+ * @retval false flash is busy
+ * 
+ * */
+bool flash_erase(uint32_t addr);
+
+#ifdef __cplusplus
+}
+#endif
+
+/** @} */
+#endif
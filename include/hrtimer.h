@@ -0,0 +1,138 @@
+/* Copyright (c) 2018 Cameron Harper
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * */
+
+#ifndef HRTIMER_H
+#define HRTIMER_H
+
+/** @file */
+
+/**
+ * @defgroup hrtimer
+ * 
+ * High resolution software timers using TC1 compare channel A
+ * 
+ * Timers share struct timer_event with the timer module but expire
+ * on counter ticks instead of TC2 ticks. Intervals in microseconds 
+ * are converted using a counter rate that is periodically measured 
+ * against the TC2 crystal, so conversion stays accurate when the 
+ * RC oscillator drifts or the system clock prescaler is changed.
+ * 
+ * Handlers are called from the TC1 compare interrupt.
+ * 
+ * Requires:
+ * 
+ * - counter_start()
+ * - timer_start()
+ * 
+ * @{
+ * */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "timer.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifndef HRTIMER_DISCIPLINE_INTERVAL
+/** TC2 ticks between counter rate measurements */
+#   define HRTIMER_DISCIPLINE_INTERVAL (8UL * TIMER_TICKS_PER_SECOND)
+#endif
+
+/**
+ * Start the timer service and counter rate measurement
+ * 
+ * The counter rate starts at the nominal value given by 
+ * counter_ticks_per_second() and is replaced by the measured
+ * value after HRTIMER_DISCIPLINE_INTERVAL.
+ * 
+ * */
+void hrtimer_start(void);
+
+/**
+ * Current value of hrtimer ticks
+ * 
+ * Same as counter_get_time().
+ * 
+ * @return counter ticks
+ * 
+ * */
+uint32_t hrtimer_get_time(void);
+
+/**
+ * Measured counter ticks per second
+ * 
+ * @return ticks per second
+ * 
+ * */
+uint32_t hrtimer_ticks_per_second(void);
+
+/**
+ * Convert microseconds to counter ticks using the measured rate
+ * 
+ * @param[in] us microseconds
+ * @return counter ticks
+ * 
+ * */
+uint32_t hrtimer_ticks(uint32_t us);
+
+/**
+ * Set a timer in microseconds
+ * 
+ * @warning do not accidentally link the same timer state more than once
+ * @warning do not link the same timer state to timer and hrtimer
+ * 
+ * @param[in] self      pointer to app managed state (see timer_init())
+ * @param[in] us        interval in microseconds
+ * @param[in] handler
+ * 
+ * */
+void hrtimer_set(volatile struct timer_event *self, uint32_t us, timer_handle_fn handler);
+
+/**
+ * Set a timer in counter ticks
+ * 
+ * @warning do not accidentally link the same timer state more than once
+ * @warning do not link the same timer state to timer and hrtimer
+ * 
+ * @param[in] self      pointer to app managed state (see timer_init())
+ * @param[in] ticks     interval in counter ticks
+ * @param[in] handler
+ * 
+ * */
+void hrtimer_set_ticks(volatile struct timer_event *self, uint32_t ticks, timer_handle_fn handler);
+
+/**
+ * Clear a timer
+ * 
+ * @param[in] self      pointer to app managed state (see timer_init())
+ * 
+ * */
+void hrtimer_clear(volatile struct timer_event *self);
+
+#ifdef __cplusplus
+}
+#endif
+
+/** @} */
+#endif
@@ -0,0 +1,159 @@
+/* Copyright (c) 2018 Cameron Harper
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * */
+
+#ifndef ICP_H
+#define ICP_H
+
+/** @file */
+
+/**
+ * @defgroup icp
+ * 
+ * TC1 input capture (ICP1/PIN_D8) for pulse width and frequency measurement
+ * 
+ * Edges are timestamped by hardware and extended to 32 bits using 
+ * the counter module overflow count. Timestamps are queued for the 
+ * mainloop and the most recent period and high time are kept for
+ * quick reads.
+ * 
+ * Requires:
+ * 
+ * - counter_start()
+ * 
+ * @{
+ * */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifndef ICP_BUFFER_SIZE
+/** number of captures that can be queued */
+#   define ICP_BUFFER_SIZE 8U
+#endif
+
+/** capture edge */
+enum icp_edge {
+    ICP_RISING,
+    ICP_FALLING,
+    ICP_BOTH            /**< alternate rising and falling */
+};
+
+/** capture record */
+struct icp_capture {
+    
+    uint32_t time;      /**< counter ticks */
+    bool level;         /**< true if rising edge */
+};
+
+/**
+ * Start capturing
+ * 
+ * Configures PIN_D8 as an input.
+ * 
+ * @param[in] edge
+ * @param[in] noise_cancel  enable the 4 sample noise canceler
+ * 
+ * */
+void icp_start(enum icp_edge edge, bool noise_cancel);
+
+/**
+ * Stop capturing
+ * 
+ * */
+void icp_stop(void);
+
+/**
+ * Get the oldest capture
+ * 
+ * @param[out] capture
+ * 
+ * @retval true
+ * @retval false no captures
+ * 
+ * */
+bool icp_read(struct icp_capture *capture);
+
+/**
+ * Were captures dropped because the buffer was full?
+ * 
+ * The condition is cleared by calling this function.
+ * 
+ * @retval true one or more captures were dropped
+ * @retval false
+ * 
+ * */
+bool icp_lost(void);
+
+/**
+ * Most recent period
+ * 
+ * Measured between rising edges, or between falling edges if
+ * capturing ICP_FALLING.
+ * 
+ * @return counter ticks (0 if not yet measured)
+ * 
+ * */
+uint32_t icp_period(void);
+
+/**
+ * Most recent high time
+ * 
+ * @note only measured when capturing ICP_BOTH
+ * 
+ * @return counter ticks (0 if not yet measured)
+ * 
+ * */
+uint32_t icp_high_time(void);
+
+/**
+ * Most recent duty cycle
+ * 
+ * @note only measured when capturing ICP_BOTH
+ * 
+ * @return high time as parts per thousand of the period (0 if not yet measured)
+ * 
+ * */
+uint16_t icp_duty(void);
+
+/**
+ * Most recent frequency
+ * 
+ * Frequencies up to UINT32_MAX millihertz (about 4.29MHz) are 
+ * represented. Shorter periods, which are only possible when the 
+ * counter runs faster than 4.29MHz, read as UINT32_MAX. The lower 
+ * end of the range is limited by the 32 bit period to 
+ * 1000 * counter_ticks_per_second() / UINT32_MAX millihertz.
+ * 
+ * @return frequency in millihertz (0 if not yet measured)
+ * 
+ * */
+uint32_t icp_frequency(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+/** @} */
+#endif
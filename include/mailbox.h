@@ -0,0 +1,128 @@
+/* Copyright (c) 2018 Cameron Harper
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * */
+
+#ifndef MAILBOX_H
+#define MAILBOX_H
+
+/** @file */
+
+/**
+ * @defgroup mailbox
+ * 
+ * Fixed size FIFO of pointers
+ * 
+ * Passes messages between interrupt and mainloop by pointer instead
+ * of copying them through a byte FIFO. Use with the pool module so 
+ * the sender allocates a block and the receiver frees it.
+ * 
+ * @code
+ * // interrupt
+ * struct message *msg = pool_alloc(&messages);
+ * 
+ * if(msg != NULL){
+ *     
+ *     // fill in msg
+ *     
+ *     if(!mailbox_put(&inbox, msg)){
+ *         
+ *         pool_free(&messages, msg);
+ *     }
+ * }
+ * 
+ * // mainloop
+ * void *msg;
+ * 
+ * if(mailbox_get(&inbox, &msg)){
+ *     
+ *     // use msg
+ *     pool_free(&messages, msg);
+ * }
+ * @endcode
+ * 
+ * @{
+ * */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+/** mailbox state */
+struct mailbox {
+    
+    void *volatile *slots;
+    size_t max;
+    volatile size_t size;
+    volatile size_t head;
+};
+
+/** 
+ * Initialise a mailbox
+ * 
+ * @param[in] self
+ * @param[in] slots     mailbox memory
+ * @param[in] max       number of slots
+ * 
+ * */
+void mailbox_init(struct mailbox *self, void *volatile *slots, size_t max);
+
+/**
+ * Post a message
+ * 
+ * @param[in] self
+ * @param[in] msg
+ * 
+ * @retval true
+ * @retval false mailbox is full
+ * 
+ * */
+bool mailbox_put(struct mailbox *self, void *msg);
+
+/**
+ * Take the oldest message
+ * 
+ * @param[in] self
+ * @param[out] msg
+ * 
+ * @retval true
+ * @retval false mailbox is empty
+ * 
+ * */
+bool mailbox_get(struct mailbox *self, void **msg);
+
+/**
+ * Number of messages waiting
+ * 
+ * @param[in] self
+ * @return messages
+ * 
+ * */
+size_t mailbox_size(struct mailbox *self);
+
+#ifdef __cplusplus
+}
+#endif
+
+/** @} */
+#endif
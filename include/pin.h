@@ -37,6 +37,8 @@ extern "C" {
 #endif
 
 #include <stdbool.h>
+#include <stdint.h>
+#include <avr/io.h>
 
 /** direction */
 enum pin_direction {PIN_INPUT, PIN_OUTPUT};
@@ -69,13 +71,39 @@ enum pin_id {
     PIN_NA      /**< not connected */
 };
 
+/** ports */
+enum pin_port {
+    PIN_PORT_D,
+    PIN_PORT_B,
+    PIN_PORT_C,
+    PIN_PORT_MAX
+};
+
+#ifndef PIN_GROUP_MAX
+/** maximum number of pins in a group */
+#   define PIN_GROUP_MAX 16U
+#endif
+
+#if PIN_GROUP_MAX > 16U
+#   error "PIN_GROUP_MAX cannot exceed 16 (group values are uint16_t)"
+#endif
+
+/** pin group state */
+struct pin_group {
+    
+    uint8_t size;
+    uint8_t mask[PIN_PORT_MAX];             /**< group bits on each port */
+    int8_t shift[PIN_PORT_MAX];             /**< port bit minus group bit */
+    bool linear[PIN_PORT_MAX];              /**< every group bit on the port has the same shift */
+    uint8_t member[PIN_GROUP_MAX];          /**< (port << 3) | bit */
+};
+
 /** pin change interrupt handler */
 typedef void (*pin_pcint_handler_t)(void);
 
 /** pin change interrupt state */
 struct pin_pcint {
     
-    bool state;
     enum pin_id id;
     enum pin_pcint_mode {
         PIN_RISING,
@@ -86,6 +114,34 @@ struct pin_pcint {
     volatile struct pin_pcint *next;
 };
 
+#ifdef PIN_EVENT
+
+#ifndef PIN_EVENT_SIZE
+/** number of pin change event records that can be queued */
+#   define PIN_EVENT_SIZE 8U
+#endif
+
+/** timestamped pin change event */
+struct pin_event {
+    
+    enum pin_id id;
+    bool level;         /**< level after the edge */
+    uint32_t time;      /**< counter_get_time() when the interrupt was entered */
+};
+
+#endif
+
+/** external interrupt handler */
+typedef void (*pin_int_handler_t)(void);
+
+/** external interrupt sense (values match ISCn1:0) */
+enum pin_int_mode {
+    PIN_INT_LOW,        /**< low level */
+    PIN_INT_CHANGE,     /**< any edge */
+    PIN_INT_FALLING,    /**< falling edge */
+    PIN_INT_RISING      /**< rising edge */
+};
+
 /**
  * get logical state of a pin
  * 
@@ -133,11 +189,159 @@ bool pin_get(enum pin_id id);
  * */
 void pin_set(enum pin_id id, enum pin_direction dir, bool on);
 
+/**
+ * toggle the output state of a pin
+ * 
+ * If the pin is an input this toggles the pullup.
+ * 
+ * @param[in] id
+ * 
+ * */
+void pin_toggle(enum pin_id id);
+
+#ifdef PIN_EVENT
+
+/**
+ * Record timestamped events for a pin change interrupt
+ * 
+ * The port state and TC1 are sampled on entry to the interrupt 
+ * and an event record is queued for each pin that changed in the
+ * requested direction. Events are read with pin_get_event() in the 
+ * order they happened.
+ * 
+ * Event recording and handlers may be used on the same pin.
+ * 
+ * @note requires PIN_EVENT; timestamps come from the counter module, 
+ *       see counter_start()
+ * 
+ * @param[in] id 
+ * @param[in] mode rising/falling/any
+ * 
+ * */
+void pin_set_pcint_event(enum pin_id id, enum pin_pcint_mode mode);
+
+/**
+ * Stop recording events for a pin
+ * 
+ * @param[in] id
+ * 
+ * */
+void pin_clear_pcint_event(enum pin_id id);
+
+/**
+ * Get the oldest pin change event
+ * 
+ * @param[out] ev
+ * 
+ * @retval true
+ * @retval false no events
+ * 
+ * */
+bool pin_get_event(struct pin_event *ev);
+
+/**
+ * Were events dropped because the event FIFO was full?
+ * 
+ * The condition is cleared by calling this function.
+ * 
+ * @retval true one or more events were dropped
+ * @retval false
+ * 
+ * */
+bool pin_event_lost(void);
+
+#endif
+
+/**
+ * Associate a handler with an external interrupt (INT0 or INT1)
+ * 
+ * Edges are detected in hardware and the handler is called directly
+ * from the interrupt vector. This has lower latency than a pin change 
+ * interrupt and will not miss short pulses.
+ * 
+ * @note only PIN_D2 (INT0) and PIN_D3 (INT1) are supported
+ * @note the handler of a low level interrupt is called for as long as the pin is low
+ * 
+ * @param[in] id        PIN_D2 or PIN_D3
+ * @param[in] mode      low/change/falling/rising
+ * @param[in] handler
+ * 
+ * @retval true
+ * @retval false pin does not support external interrupts
+ * 
+ * */
+bool pin_set_int_handler(enum pin_id id, enum pin_int_mode mode, pin_int_handler_t handler);
+
+/**
+ * Disable external interrupt
+ * 
+ * @param[in] id        PIN_D2 or PIN_D3
+ * 
+ * */
+void pin_clear_int_handler(enum pin_id id);
+
+/**
+ * Initialise a group of pins
+ * 
+ * Bit n of a group value corresponds to ids[n]. PIN_NA may be
+ * used as a placeholder for a bit that has no pin.
+ * 
+ * Masks are precomputed so that a group access costs one register
+ * access per port. Pins on the same port that have the same order
+ * in the group as they do on the port (e.g. PIN_D0 to PIN_D7) are
+ * translated by a single shift.
+ * 
+ * @param[in] self
+ * @param[in] ids   pins in group bit order
+ * @param[in] size  number of pins (up to PIN_GROUP_MAX)
+ * 
+ * @retval true
+ * @retval false too many pins
+ * 
+ * */
+bool pin_group_init(struct pin_group *self, const enum pin_id *ids, uint8_t size);
+
+/**
+ * Set the direction of every pin in a group
+ * 
+ * @param[in] self
+ * @param[in] dir
+ * 
+ * */
+void pin_group_direction(const struct pin_group *self, enum pin_direction dir);
+
+/**
+ * Read every pin in a group
+ * 
+ * Each port is read once.
+ * 
+ * @param[in] self
+ * @return group value
+ * 
+ * */
+uint16_t pin_group_get(const struct pin_group *self);
+
+/**
+ * Write every pin in a group
+ * 
+ * Each port is updated by a single masked write so pins on the same 
+ * port change together. Other pins on the port are unaffected.
+ * 
+ * @param[in] self
+ * @param[in] value group value
+ * 
+ * */
+void pin_group_set(const struct pin_group *self, uint16_t value);
+
 /**
  * Associate a handle function with a pin change interrupt
  * 
  * @note it is posible to have more than one handler on a single PCINT
  * 
+ * Each port is read once per interrupt and compared with the previous
+ * reading. Only handlers on pins that changed in the requested 
+ * direction are called.
+ * 
  * @param[in] self linked into a queue of PCINTs
  * @param[in] id 
  * @param[in] mode rising/falling/any
@@ -154,6 +358,118 @@ void pin_set_pcint_handler(volatile struct pin_pcint *self, enum pin_id id, enum
  * */
 void pin_clear_pcint_handler(const struct pin_pcint *self);
 
+/** @private register of the port that ID belongs to */
+#define PIN_REG(ID, D, B, C) (((ID) <= PIN_D7) ? &(D) : (((ID) <= PIN_D13) ? &(B) : &(C)))
+
+/** @private port that ID belongs to */
+#define PIN_PORT(ID) ((enum pin_port)( \
+    ((ID) <= PIN_D7) ? PIN_PORT_D : \
+    ((ID) <= PIN_D13) ? PIN_PORT_B : \
+    PIN_PORT_C))
+
+/** @private id of BIT within PORT */
+#define PIN_ID(PORT, BIT) ((enum pin_id)( \
+    ((PORT) == PIN_PORT_D) ? (uint8_t)(BIT) : \
+    ((PORT) == PIN_PORT_B) ? ((uint8_t)PIN_D8 + (uint8_t)(BIT)) : \
+    ((uint8_t)PIN_A0 + (uint8_t)(BIT))))
+
+/** @private bit within the port that ID belongs to */
+#define PIN_BIT(ID) ((uint8_t)( \
+    ((ID) <= PIN_D7) ? (uint8_t)(ID) : \
+    ((ID) <= PIN_D13) ? ((uint8_t)(ID) - (uint8_t)PIN_D8) : \
+    ((uint8_t)(ID) - (uint8_t)PIN_A0)))
+
+/**
+ * pin_get() resolved at compile time
+ * 
+ * A constant id compiles to a single port read (i.e. sbis/sbic or in). 
+ * Otherwise this calls pin_get().
+ * 
+ * @param[in] id
+ * 
+ * @retval true pin is high
+ * @retval false pin is low
+ * 
+ * */
+static inline bool pin_get_fast(enum pin_id id) __attribute__((always_inline));
+static inline bool pin_get_fast(enum pin_id id)
+{
+    bool retval = false;
+    
+    if(!__builtin_constant_p(id)){
+        
+        retval = pin_get(id);
+    }
+    else if(id != PIN_NA){
+        
+        retval = ((*PIN_REG(id, PIND, PINB, PINC) & _BV(PIN_BIT(id))) > 0U);
+    }
+    
+    return retval;
+}
+
+/**
+ * pin_set() resolved at compile time
+ * 
+ * A constant id compiles to sbi/cbi on DDRx and PORTx.
+ * Otherwise this calls pin_set().
+ * 
+ * @param[in] id 
+ * @param[in] dir   direction of pin
+ * @param[in] on    true if high
+ * 
+ * */
+static inline void pin_set_fast(enum pin_id id, enum pin_direction dir, bool on) __attribute__((always_inline));
+static inline void pin_set_fast(enum pin_id id, enum pin_direction dir, bool on)
+{
+    if(!__builtin_constant_p(id)){
+        
+        pin_set(id, dir, on);
+    }
+    else if(id != PIN_NA){
+        
+        if(dir == PIN_OUTPUT){
+            
+            *PIN_REG(id, DDRD, DDRB, DDRC) |= _BV(PIN_BIT(id));
+        }
+        else{
+            
+            *PIN_REG(id, DDRD, DDRB, DDRC) &= ~_BV(PIN_BIT(id));
+        }
+        
+        if(on){
+            
+            *PIN_REG(id, PORTD, PORTB, PORTC) |= _BV(PIN_BIT(id));
+        }
+        else{
+            
+            *PIN_REG(id, PORTD, PORTB, PORTC) &= ~_BV(PIN_BIT(id));
+        }
+    }
+}
+
+/**
+ * pin_toggle() resolved at compile time
+ * 
+ * A constant id compiles to a single write to PINx.
+ * Otherwise this calls pin_toggle().
+ * 
+ * @param[in] id
+ * 
+ * */
+static inline void pin_toggle_fast(enum pin_id id) __attribute__((always_inline));
+static inline void pin_toggle_fast(enum pin_id id)
+{
+    if(!__builtin_constant_p(id)){
+        
+        pin_toggle(id);
+    }
+    else if(id != PIN_NA){
+        
+        *PIN_REG(id, PIND, PINB, PINC) = _BV(PIN_BIT(id));
+    }
+}
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,106 @@
+/* Copyright (c) 2018 Cameron Harper
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * */
+
+#ifndef POOL_H
+#define POOL_H
+
+/** @file */
+
+/**
+ * @defgroup pool
+ * 
+ * Fixed block memory pool
+ * 
+ * Free blocks are kept in a list threaded through the blocks
+ * themselves so there is no per-block overhead. Allocate and free
+ * are O(1) and safe from interrupts.
+ * 
+ * @code
+ * static struct message mem[4];
+ * static struct pool messages;
+ * 
+ * pool_init(&messages, mem, sizeof(mem[0]), sizeof(mem)/sizeof(mem[0]));
+ * @endcode
+ * 
+ * @{
+ * */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+/** pool state */
+struct pool {
+    
+    void *volatile free;    /**< first free block */
+    volatile size_t count;  /**< number of free blocks */
+};
+
+/**
+ * Initialise a pool
+ * 
+ * @param[in] self
+ * @param[in] buffer        pool memory (block_size * blocks bytes)
+ * @param[in] block_size    size of each block (at least sizeof(void *))
+ * @param[in] blocks        number of blocks
+ * 
+ * */
+void pool_init(struct pool *self, void *buffer, size_t block_size, size_t blocks);
+
+/**
+ * Allocate a block
+ * 
+ * @param[in] self
+ * @return pointer to block (NULL if none are free)
+ * 
+ * */
+void *pool_alloc(struct pool *self);
+
+/**
+ * Return a block to the pool
+ * 
+ * @warning block must have come from pool_alloc() on the same pool
+ * 
+ * @param[in] self
+ * @param[in] block
+ * 
+ * */
+void pool_free(struct pool *self, void *block);
+
+/**
+ * Number of free blocks
+ * 
+ * @param[in] self
+ * @return free blocks
+ * 
+ * */
+size_t pool_available(struct pool *self);
+
+#ifdef __cplusplus
+}
+#endif
+
+/** @} */
+#endif
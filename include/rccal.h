@@ -25,17 +25,20 @@
 /**
  * @defgroup rccal
  * 
- * Hardware dependent RC oscillator calibration using TC0 and asynchronous TC2
+ * Hardware dependent RC oscillator calibration using TC1 and asynchronous TC2
  * 
- * This code will calibrate the RC oscillator to 
- * within +-1% of the prescaled nominal frequency.
+ * This code will calibrate the RC oscillator to within 
+ * RCCAL_TOLERANCE_PPM of the prescaled nominal frequency (F_CPU 
+ * divided by the CLKPR setting when calibration starts) or of a
+ * frequency set by rccal_set_target().
  * 
  * It is currently very fixed to a particular hardware configuration
- * and takes up an ISR.
+ * and takes up the TC2 compare B ISR.
  * 
  * Works as follows:
  * 
- * - counts number of TC0 ticks in one TC2 tick
+ * - timestamps TC2 compare B interrupts with the counter module (TC1)
+ * - each interrupt ends one measurement window and starts the next
  * - takes up to 8 measurements in OSCCAL binary search
  * - checks 4 nearest neighbours 
  * - if calibration fails the factory calibration byte is restored
@@ -44,8 +47,7 @@
  * 
  * - TC2 in asynchronous mode clocked from a 32768KHZ source
  * - TC2 1024 divider (overflow every 8 seconds)
- * - TC0 1 divider
- * - system prescaler 2 (i.e. 4MHz io clock)
+ * - counter_start(COUNTER_DIV_1)
  * 
  * @{
  * */
@@ -57,23 +59,37 @@ extern "C" {
 #include <stdbool.h>
 #include <stdint.h>
 
+#ifndef RCCAL_TOLERANCE_PPM
+/** calibration tolerance in parts per million (tracking uses half) */
+#   define RCCAL_TOLERANCE_PPM 10000UL
+#endif
+
+#ifndef RCCAL_FINE_WINDOW
+/** TC2 ticks per measurement for the last binary search step */
+#   define RCCAL_FINE_WINDOW 2U
+#endif
+
 /** calibration result */
 enum rccal_result {
     RCCAL_RESULT_NA,    /**< calibration not complete */
-    RCCAL_RESULT_PASS,  /**< within +/- 1% */
-    RCCAL_RESULT_FAIL   /**< not within +/- 1% */
+    RCCAL_RESULT_PASS,  /**< within RCCAL_TOLERANCE_PPM */
+    RCCAL_RESULT_FAIL   /**< not within RCCAL_TOLERANCE_PPM */
 };
 
 /**
  * start calibration procedure
  * 
  * This procedure will try to calibrate the RC oscillator to 
- * within +-1% of the prescaled nominal frequency. Should
- * the procedure fail, the best calibration will remain set.
+ * within RCCAL_TOLERANCE_PPM of the target frequency. Should
+ * the procedure fail, the factory calibration is restored.
  * 
  * The calibration alogrithm works by measuring the number of RC ticks within
  * a given reference window. This measurement is then compared against the acceptible
- * range for +-1% accuracy. 
+ * range for the tolerance. The range is worked out from F_CPU and CLKPR 
+ * (or the rccal_set_target() frequency) when calibration starts.
+ * 
+ * One OSCCAL step is roughly 0.5% to 1%, so a tolerance much tighter 
+ * than half a step may not be achievable. 
  * 
  * Up to 8 measurements are made to zero into an appropriate value by
  * way of binary search. Should this fail, the fourth nearest neighbours 
@@ -84,21 +100,26 @@ enum rccal_result {
  * case search time by one measurement. This quirk exists to save a 
  * small amount of RAM and complexity.
  * 
- * Another implementation quirk means that to synchronise the measurements
- * correctly, we have to add in additional ticks which cause the calibration
- * to take longer.
- * 
- * Bearing that in mind, each measurement takes:
+ * Measurements are back to back, the window ending at one TC2 tick 
+ * starts the next. Every measurement uses a one tick window except 
+ * the last binary search step, which uses RCCAL_FINE_WINDOW ticks to
+ * average out interrupt latency. The worst case (calibration fails) 
+ * is:
  * 
- * Tmeasure = (RCCAL_T2_TICKS + 2) * RCCAL_T2_DIV / 32786 seconds
+ * Tcalibration = (2 + 11*1 + RCCAL_FINE_WINDOW) / 32 seconds
  * 
- * Calibration therefore takes:
+ * For the default values, calibration will complete in:
  * 
- * Tcalibration = Tmeasure * (8 + 5) seconds
+ * 15 / 32 = 0.46875 seconds
  * 
- * For the default values, calibration will complete in:
+ * A window cannot be shorter than one TC2 tick because TC2 is shared
+ * with the timer module, which fixes its prescaler at 1024. This 
+ * bounds calibration time to about 2.6 times faster than the 39 tick
+ * worst case of counting TC0 overflows, not an order of magnitude.
  * 
- * (2*512/32768) * (8 + 5) = 0.40625 seconds
+ * Each measurement takes one TC2 compare B interrupt. Windows are 
+ * timed with the counter module, so its TC1 overflow interrupt also 
+ * runs every 65536 io clock cycles (about 4 times per window at 8MHz).
  * 
  * */
  
@@ -109,6 +130,79 @@ enum rccal_result {
  * */
 void rccal_start(void);
 
+/**
+ * Set the io clock frequency to calibrate to
+ * 
+ * Takes effect when calibration or tracking next starts.
+ * 
+ * @note modules that assume F_CPU (e.g. uart, counter) will be off by the difference
+ * 
+ * @param[in] hz io clock in Hz (0 for F_CPU divided by the CLKPR setting)
+ * 
+ * */
+void rccal_set_target(uint32_t hz);
+
+/**
+ * Io clock frequency that makes a UART baud rate exact
+ * 
+ * Uses the UBRR0/U2X0 setting that uart_init() will choose at 
+ * the nominal clock and returns the clock that makes that setting
+ * give exactly baud. Use with rccal_set_target().
+ * 
+ * @code
+ * rccal_set_target(rccal_baud_target(115200UL));
+ * rccal_start();
+ * while(rccal_is_active());
+ * uart_init(115200UL, NULL, NULL);
+ * @endcode
+ * 
+ * @param[in] baud
+ * @return io clock in Hz
+ * 
+ * */
+uint32_t rccal_baud_target(uint32_t baud);
+
+/**
+ * Start tracking the RC oscillator
+ * 
+ * Each measurement window is interval TC2 ticks long and OSCCAL
+ * is nudged by one step if the error is more than half the 
+ * calibration tolerance. This keeps the clock within tolerance
+ * as temperature and supply voltage change.
+ * 
+ * OSCCAL is not moved between its two overlapping ranges, run
+ * rccal_start() first to choose the range. If calibration is in 
+ * progress tracking starts once it finishes.
+ * 
+ * TC1 stops during power-save sleep (e.g. timer_sleep_until_next()),
+ * which makes a window that spans a sleep read short. Windows that 
+ * read less than half the target are discarded, but a sleep that 
+ * covers only a small part of a window will nudge OSCCAL the wrong 
+ * way for one window. Sleep in idle mode while tracking, or stop 
+ * tracking with rccal_track_stop() before sleeping in power-save.
+ * 
+ * @param[in] interval TC2 ticks per measurement (at least 1)
+ * 
+ * */
+void rccal_track_start(uint8_t interval);
+
+/**
+ * Stop tracking
+ * 
+ * Calibration started by rccal_start() is not affected.
+ * 
+ * */
+void rccal_track_stop(void);
+
+/**
+ * is tracking enabled?
+ * 
+ * @retval true     enabled
+ * @retval false
+ * 
+ * */
+bool rccal_is_tracking(void);
+
 /**
  * is calibration in progress?
  *
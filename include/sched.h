@@ -0,0 +1,136 @@
+/* Copyright (c) 2018 Cameron Harper
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * */
+
+#ifndef SCHED_H
+#define SCHED_H
+
+/** @file */
+
+/**
+ * @defgroup sched
+ * 
+ * Run-to-completion event scheduler
+ * 
+ * Up to eight tasks are declared at build time in a table indexed 
+ * by priority, which is kept in flash. Interrupts and other tasks 
+ * post events to a task by priority. Each task keeps a byte of 
+ * pending event bits and the scheduler keeps a byte of ready tasks, 
+ * so posting is two OR operations and choosing the next task is a 
+ * table lookup regardless of how many events are pending.
+ * 
+ * A task handler is called with the event bits posted since it last 
+ * ran, and runs to completion. Higher priority tasks do not preempt 
+ * a running task but always run next.
+ * 
+ * @code
+ * SCHED_TASK_TABLE(tasks) = {
+ *     [TASK_UI] = ui_task,
+ *     [TASK_RADIO] = radio_task
+ * };
+ * 
+ * // in an interrupt or timer handler
+ * sched_post(TASK_RADIO, RADIO_EVENT_RX);
+ * 
+ * // in main
+ * sched_init(tasks);
+ * sched_run();
+ * @endcode
+ * 
+ * @{
+ * */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <avr/pgmspace.h>
+
+/** number of tasks (one per bit of the ready mask) */
+#define SCHED_TASKS 8U
+
+/** 
+ * task handler
+ * 
+ * @param[in] events event bits posted since the task last ran
+ * 
+ * */
+typedef void (*sched_handler_t)(uint8_t events);
+
+/**
+ * Declare a task table
+ * 
+ * Index n is the handler of the task at priority n (higher runs 
+ * first). Unused priorities are left NULL and events posted to
+ * them are discarded.
+ * 
+ * @param[in] NAME
+ * 
+ * */
+#define SCHED_TASK_TABLE(NAME) const sched_handler_t NAME[SCHED_TASKS] PROGMEM
+
+/**
+ * Initialise the scheduler with a task table
+ * 
+ * Pending events are discarded.
+ * 
+ * @param[in] tasks table declared with SCHED_TASK_TABLE()
+ * 
+ * */
+void sched_init(const sched_handler_t *tasks);
+
+/**
+ * Post events to a task
+ * 
+ * Safe to call from interrupts. Events that are already pending 
+ * are merged.
+ * 
+ * @param[in] priority  task
+ * @param[in] events    event bits (must be non-zero)
+ * 
+ * */
+void sched_post(uint8_t priority, uint8_t events);
+
+/**
+ * Run the highest priority ready task
+ * 
+ * @retval true a task was run
+ * @retval false no tasks were ready
+ * 
+ * */
+bool sched_dispatch(void);
+
+/**
+ * Run tasks forever
+ * 
+ * Sleeps (in the mode selected by set_sleep_mode()) when no tasks are
+ * ready. An interrupt that posts an event wakes the scheduler.
+ * 
+ * */
+void sched_run(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+/** @} */
+#endif
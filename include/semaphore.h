@@ -44,6 +44,21 @@ struct semaphore {
     volatile uint8_t count;
 };
 
+/** 
+ * single signaller/single waiter semaphore state
+ * 
+ * Each side only writes its own counter and the count is the 
+ * difference between them, so no operation needs to disable 
+ * interrupts.
+ * 
+ * */
+struct semaphore_spsc {
+    
+    uint8_t max;
+    volatile uint8_t signalled;     /**< written only by the signaller */
+    volatile uint8_t taken;         /**< written only by the waiter */
+};
+
 /**
  * Initialise a semaphore
  * 
@@ -81,6 +96,47 @@ bool semaphore_wait(struct semaphore *self);
  * */
 bool semaphore_peek(struct semaphore *self);
 
+/**
+ * Initialise a single signaller/single waiter semaphore
+ * 
+ * @param[in] self
+ * @param[in] max semaphore will count to this value (at most 255)
+ * 
+ * */
+void semaphore_spsc_init(struct semaphore_spsc *self, uint8_t max);
+
+/**
+ * Signal (count up) a single signaller/single waiter semaphore
+ * 
+ * @warning only one context (e.g. one interrupt) may signal
+ * 
+ * @param[in] self
+ * 
+ * */
+void semaphore_spsc_signal(struct semaphore_spsc *self);
+
+/**
+ * Wait (count down) on a single signaller/single waiter semaphore
+ * 
+ * @warning only one context (e.g. the mainloop) may wait
+ * 
+ * @param[in] self
+ * @retval true
+ * @retval false still waiting for a signal
+ * 
+ * */
+bool semaphore_spsc_wait(struct semaphore_spsc *self);
+
+/**
+ * Check if wait will succeed without affecting the state
+ * 
+ * @param[in] self
+ * @retval true wait will succeed
+ * @retval false
+ * 
+ * */
+bool semaphore_spsc_peek(const struct semaphore_spsc *self);
+
 #ifdef __cplusplus
 }
 #endif
@@ -39,6 +39,17 @@ extern "C" {
 #endif
 
 #include <stdint.h>
+#include <avr/io.h>
+
+#ifndef SPI_CLKPR
+/** system clock prescaler setting (CLKPR) assumed by SPI_INIT() */
+#   define SPI_CLKPR 0U
+#endif
+
+#ifndef SPI_RATE_TOLERANCE
+/** SPI_INIT() fails to compile if the selected rate is more than this percentage below the requested rate */
+#   define SPI_RATE_TOLERANCE 20U
+#endif
 
 /** SPI mode */
 enum spi_mode {
@@ -65,6 +76,17 @@ enum spi_order {
  * */
 void spi_init(enum spi_mode mode, enum spi_order order, uint32_t rate);
 
+/**
+ * Initialise SPI from precomputed register values
+ * 
+ * @note normally called via SPI_INIT()
+ * 
+ * @param[in] spcr  SPCR value
+ * @param[in] spsr  SPSR value
+ * 
+ * */
+void spi_init_setting(uint8_t spcr, uint8_t spsr);
+
 /**
  * Write (and read) SPI
  * 
@@ -74,6 +96,65 @@ void spi_init(enum spi_mode mode, enum spi_order order, uint32_t rate);
  * */
 uint8_t spi_write(uint8_t data);
 
+/** io clock assumed by SPI_INIT() */
+#define SPI_F_IO ((uint32_t)(F_CPU) >> (SPI_CLKPR))
+
+/** index of the fastest divider (2 << index) that does not exceed rate */
+#define SPI_CLOCK_INDEX(RATE) ( \
+    ((RATE) >= (SPI_F_IO >> 1U)) ? 0U : \
+    ((RATE) >= (SPI_F_IO >> 2U)) ? 1U : \
+    ((RATE) >= (SPI_F_IO >> 3U)) ? 2U : \
+    ((RATE) >= (SPI_F_IO >> 4U)) ? 3U : \
+    ((RATE) >= (SPI_F_IO >> 5U)) ? 4U : \
+    ((RATE) >= (SPI_F_IO >> 6U)) ? 5U : \
+    6U)
+
+/** clock rate in Hz that SPI_INIT() will produce for rate */
+#define SPI_ACTUAL_RATE(RATE) (SPI_F_IO >> (SPI_CLOCK_INDEX(RATE) + 1U))
+
+/** SPR1:0 and SPI2X packed as (SPR1:0 << 1) | SPI2X */
+#define SPI_CLOCK_SELECT(RATE) (((SPI_CLOCK_INDEX(RATE) == 6U) ? 7U : SPI_CLOCK_INDEX(RATE)) ^ 1U)
+
+/** true if the selected rate does not exceed rate (false below the slowest divider) */
+#define SPI_RATE_NOT_FASTER(RATE) (SPI_ACTUAL_RATE(RATE) <= (RATE))
+
+/** true if rate can be met within SPI_RATE_TOLERANCE without going over */
+#define SPI_RATE_OK(RATE) ( \
+    SPI_RATE_NOT_FASTER(RATE) && \
+    ((SPI_ACTUAL_RATE(RATE) * 100ULL) >= ((RATE) * (100ULL - (SPI_RATE_TOLERANCE)))))
+
+/** SPCR value for a mode, order and rate */
+#define SPI_SPCR(MODE, ORDER, RATE) ((uint8_t)( \
+    _BV(MSTR) | _BV(SPE) | \
+    (((ORDER) == SPI_ORDER_LSB) ? _BV(DORD) : 0U) | \
+    (uint8_t)(MODE) | \
+    ((SPI_CLOCK_SELECT(RATE) >> 1U) & 3U)))
+
+/** SPSR value for a rate */
+#define SPI_SPSR(RATE) ((uint8_t)(SPI_CLOCK_SELECT(RATE) & 1U))
+
+/**
+ * Initialise SPI with settings resolved at compile time
+ * 
+ * Equivalent to spi_init() except that all arguments must be constant
+ * and the io clock is assumed to be F_CPU prescaled by SPI_CLKPR.
+ * Compilation fails if the selected rate would be faster than rate,
+ * or slower by more than SPI_RATE_TOLERANCE percent.
+ * 
+ * Use spi_init() if the rate or the system prescaler is only
+ * known at runtime.
+ * 
+ * @code
+ * SPI_INIT(SPI_MODE_0, SPI_ORDER_MSB, 1000000UL);
+ * @endcode
+ * 
+ * */
+#define SPI_INIT(MODE, ORDER, RATE) do{ \
+    _Static_assert(SPI_RATE_NOT_FASTER(RATE), "SPI rate is slower than the slowest divider"); \
+    _Static_assert(SPI_RATE_OK(RATE), "SPI rate cannot be met within SPI_RATE_TOLERANCE"); \
+    spi_init_setting(SPI_SPCR(MODE, ORDER, RATE), SPI_SPSR(RATE)); \
+}while(0)
+
 #ifdef __cplusplus
 }
 #endif
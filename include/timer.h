@@ -27,18 +27,76 @@
 
 #define TIMER_TICKS_PER_SECOND (256UL/8UL)
 
+/* The wheel advances one tick per step. The compare interrupt steps
+ * through every tick since it last ran, which is up to one TC2 period
+ * (256 ticks) when only distant timers are set, or more if the 
+ * interrupt is held off. Up to UINT16_MAX timers may be linked. */
+#ifdef TIMER_WHEEL
+#   ifndef TIMER_WHEEL_BITS
+/** timing wheel has (1 << TIMER_WHEEL_BITS) slots per level */
+#       define TIMER_WHEEL_BITS 4U
+#   endif
+#   ifndef TIMER_WHEEL_LEVELS
+/** number of timing wheel levels */
+#       define TIMER_WHEEL_LEVELS 4U
+#   endif
+#endif
+
+#ifdef TIMER_PROFILE
+#   ifndef TIMER_PROFILE_BUCKETS
+/** number of log2 histogram buckets */
+#       define TIMER_PROFILE_BUCKETS 12U
+#   endif
+#endif
+
 struct timer_event;
 
 typedef void (*timer_handle_fn)(volatile struct timer_event *ev);
 
+/** 
+ * timer state
+ * 
+ * @note initialise with timer_init() before first use unless it has
+ *       static storage (which is zero initialised)
+ * 
+ * */
 struct timer_event {
     volatile struct timer_event *next;    
+    volatile struct timer_event *volatile *prev;    /**< link that points to this event (NULL if not linked) */
     uint32_t timeout;
-    uint32_t interval;
-    bool once;
+    uint32_t expiry;                                /**< timeout moved later within slack */
+    uint32_t slack;                                 /**< ticks the timer may expire late by */
+    uint32_t interval;                              /**< period of a periodic timer */
+    bool once;                                      /**< false if the timer re-arms itself on expiry */
+    bool deferred;                                  /**< handler is called from timer_dispatch() */
+    volatile struct timer_event *ready;             /**< next event in the ready queue */
+#ifdef TIMER_PROFILE
+    struct timer_profile *profile;                  /**< NULL if not profiled */
+#endif
     timer_handle_fn handler;
 };
 
+#ifdef TIMER_PROFILE
+/**
+ * timer profile
+ * 
+ * Histogram bucket 0 counts zero values and bucket n counts values
+ * in [2^(n-1), 2^n). The last bucket also counts everything larger.
+ * Buckets saturate at UINT16_MAX.
+ * 
+ * */
+struct timer_profile {
+    uint32_t count;                                 /**< number of expiries */
+    uint32_t late_min;                              /**< counter ticks */
+    uint32_t late_max;                              /**< counter ticks */
+    uint16_t late[TIMER_PROFILE_BUCKETS];           /**< expiry minus deadline (counter ticks) */
+    uint32_t exec_count;                            /**< number of handler calls */
+    uint32_t exec_min;                              /**< counter ticks */
+    uint32_t exec_max;                              /**< counter ticks */
+    uint16_t exec[TIMER_PROFILE_BUCKETS];           /**< handler execution time (counter ticks) */
+};
+#endif
+
 /**
  * Initialise the underlying timer/counter to start the timer ticking
  * 
@@ -48,26 +106,212 @@ void timer_start(void);
 /** 
  * Current value of timer ticks
  * 
+ * Does not disable interrupts.
+ * 
  * @return timer ticks
  * 
  * */
 uint32_t timer_get_time(void);
 
+/** 
+ * Current value of timer ticks extended to 64 bits
+ * 
+ * The lower 32 bits are the same as timer_get_time(). Use this for 
+ * timestamps that must not wrap.
+ * 
+ * @return timer ticks
+ * 
+ * */
+uint64_t timer_get_time64(void);
+
+/**
+ * Convert milliseconds to timer ticks
+ * 
+ * @param[in] ms milliseconds
+ * @return timer ticks (rounded up)
+ * 
+ * */
+uint32_t timer_ms_to_ticks(uint32_t ms);
+
+/**
+ * Convert timer ticks to milliseconds
+ * 
+ * @param[in] ticks timer ticks
+ * @return milliseconds (rounded down)
+ * 
+ * */
+uint64_t timer_ticks_to_ms(uint64_t ticks);
+
+/**
+ * Initialise timer state
+ * 
+ * Required before the first use of a timer in automatic or 
+ * allocated storage, since the links in uninitialised state would 
+ * otherwise be followed by timer_set() and timer_clear().
+ * 
+ * @warning do not call on a timer that is set
+ * 
+ * @param[in] self      pointer to app managed state
+ * 
+ * */
+void timer_init(volatile struct timer_event *self);
+
 /**
  * Set a timer
  * 
+ * By default timers are kept in a list sorted by timeout which
+ * makes setting a timer O(n). Define TIMER_WHEEL to use a 
+ * hierarchical timing wheel instead which makes setting a timer
+ * O(1) at the cost of (TIMER_WHEEL_LEVELS << TIMER_WHEEL_BITS) pointers 
+ * of RAM. Clearing a timer is O(1) in both cases.
+ * 
  * @warning do not accidentally link the same timer state more than once
  * 
- * @param[in] self      pointer to app managed state
+ * @param[in] self      pointer to app managed state (see timer_init())
  * @param[in] interval
  * @param[in] handler
  * 
  * */
 void timer_set(volatile struct timer_event *self, uint32_t interval, timer_handle_fn handler);
 
+/**
+ * Set a timer with a deferred handler
+ * 
+ * When the timer expires the interrupt only moves it to a ready
+ * queue. The handler is called from the mainloop by timer_dispatch(). 
+ * Use this for handlers that are too slow to run in an interrupt.
+ * 
+ * If the timer expires again before it has been dispatched the 
+ * handler is only called once.
+ * 
+ * @warning do not accidentally link the same timer state more than once
+ * 
+ * @param[in] self      pointer to app managed state
+ * @param[in] interval
+ * @param[in] handler
+ * 
+ * */
+void timer_set_deferred(volatile struct timer_event *self, uint32_t interval, timer_handle_fn handler);
+
+/**
+ * Set a periodic timer
+ * 
+ * The timer first expires after interval and then every interval
+ * after the previous deadline, so the phase does not drift with
+ * interrupt latency. If expiries were missed the handler is called
+ * once for each of them.
+ * 
+ * The timer is re-armed before the handler is called. Use timer_clear()
+ * to stop it (including from the handler).
+ * 
+ * @warning do not accidentally link the same timer state more than once
+ * 
+ * @param[in] self      pointer to app managed state
+ * @param[in] interval  period (must be greater than zero)
+ * @param[in] handler
+ * 
+ * */
+void timer_set_periodic(volatile struct timer_event *self, uint32_t interval, timer_handle_fn handler);
+
+/**
+ * Ticks until the timer service next needs to run
+ * 
+ * With TIMER_WHEEL this may be earlier than the nearest timeout 
+ * since the wheel must also run to cascade timers down.
+ * 
+ * @return ticks until the next expiry (UINT32_MAX if no timers are set)
+ * 
+ * */
+uint32_t timer_next(void);
+
+/**
+ * Enter power-save sleep until the next timer expires
+ * 
+ * OCR2A is programmed for the nearest deadline and the TC2 
+ * asynchronous update flags are waited on so that the device is 
+ * certain to wake again. Returns immediately if deferred handlers 
+ * are waiting.
+ * 
+ * Other enabled interrupts will also wake the device.
+ * 
+ * Call with interrupts enabled, they are enabled on return.
+ * 
+ * @return ticks the wakeup was late by (negative if woken early, 0 if no timers were set)
+ * 
+ * */
+int32_t timer_sleep_until_next(void);
+
+/**
+ * Are deferred handlers waiting to be dispatched?
+ * 
+ * @retval true
+ * @retval false
+ * 
+ * */
+bool timer_poll(void);
+
+/**
+ * Call the handlers of expired deferred timers
+ * 
+ * Call this from the mainloop.
+ * 
+ * */
+void timer_dispatch(void);
+
+/**
+ * Allow a timer to expire late
+ * 
+ * The timer is moved to the tick within [timeout, timeout + slack]
+ * that has the most trailing zeros. Timers with loose deadlines 
+ * then tend to share a tick and a single compare interrupt (and 
+ * wakeup from sleep). 
+ * 
+ * Takes effect the next time the timer is set or a periodic timer
+ * re-arms. A periodic timer keeps its phase since the period is
+ * added to the original deadline.
+ * 
+ * @param[in] self      pointer to app managed state
+ * @param[in] slack     ticks (0 to expire exactly)
+ * 
+ * */
+void timer_set_slack(volatile struct timer_event *self, uint32_t slack);
+
+#ifdef TIMER_PROFILE
+/**
+ * Attach a profile to a timer
+ * 
+ * The profile is cleared and then updated every time the timer
+ * expires with how late the expiry was, and every time the handler
+ * runs with how long it took. Both are measured in counter ticks so
+ * that lateness within one timer tick is visible; lateness is taken
+ * from entry to the compare interrupt, so the latency of the 
+ * interrupt itself is not included.
+ * 
+ * Requires counter_start().
+ * 
+ * @param[in] self      pointer to app managed state
+ * @param[in] profile   pointer to app managed profile (NULL to detach)
+ * 
+ * */
+void timer_set_profile(volatile struct timer_event *self, struct timer_profile *profile);
+
+/**
+ * Copy the profile of a timer
+ * 
+ * @param[in] self      pointer to app managed state
+ * @param[out] profile  copy (zeroed if the timer is not profiled)
+ * 
+ * */
+void timer_get_profile(volatile const struct timer_event *self, struct timer_profile *profile);
+#endif
+
 /**
  * Clear a timer
  * 
+ * A deferred timer that has expired but not been dispatched is 
+ * also removed from the ready queue. Clearing a timer that is not
+ * set has no effect.
+ * 
  * @param[in] self      pointer to app managed state
  * 
  * 
@@ -84,9 +328,9 @@ void timer_clear(volatile struct timer_event *self);
  * uint32_t interval_since_timestamp = timer_interval(timestamp, timer_get_time());
  * @endcode
  * 
- * @param[in] t1
- * @param[in] t2
- * @return difference between t1 and t2
+ * @param[in] t1    earlier reading
+ * @param[in] t2    later reading
+ * @return ticks from t1 to t2 (correct across wraparound)
  * 
  * */
 uint32_t timer_interval(uint32_t t1, uint32_t t2);
@@ -0,0 +1,130 @@
+/* Copyright (c) 2018 Cameron Harper
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * */
+
+#include "coro.h"
+
+#include <stddef.h>
+
+static struct coro *coros;
+
+/* static function prototypes *****************************************/
+
+static bool ready(struct coro *self);
+
+/* functions **********************************************************/
+
+void coro_start(struct coro *self, coro_fn fn)
+{
+    coro_stop(self);
+    
+    self->fn = fn;
+    self->line = 0U;
+    self->wait = CORO_WAIT_NONE;
+    
+    self->next = coros;
+    coros = self;
+}
+
+void coro_stop(struct coro *self)
+{
+    struct coro **link = &coros;
+    
+    while(*link != NULL){
+        
+        if(*link == self){
+            
+            *link = self->next;
+            break;
+        }
+        
+        link = &(*link)->next;
+    }
+    
+    self->next = NULL;
+    self->wait = CORO_WAIT_DONE;
+}
+
+bool coro_done(const struct coro *self)
+{
+    return (self->wait == CORO_WAIT_DONE);
+}
+
+bool coro_poll(void)
+{
+    bool retval = false;
+    struct coro **link = &coros;
+    
+    while(*link != NULL){
+        
+        struct coro *self = *link;
+        
+        if(ready(self)){
+            
+            self->fn(self);
+            retval = true;
+        }
+        
+        /* the coroutine may have stopped itself */
+        if(*link == self){
+            
+            if(self->wait == CORO_WAIT_DONE){
+                
+                *link = self->next;
+                self->next = NULL;
+            }
+            else{
+                
+                link = &self->next;
+            }
+        }
+    }
+    
+    return retval;
+}
+
+/* static functions ***************************************************/
+
+static bool ready(struct coro *self)
+{
+    bool retval;
+    
+    switch(self->wait){
+    default:
+    case CORO_WAIT_DONE:
+        retval = false;
+        break;
+    case CORO_WAIT_NONE:
+        retval = true;
+        break;
+    case CORO_WAIT_FIFO:
+        retval = (fifo_size((volatile struct fifo *)self->object) >= self->n);
+        break;
+    case CORO_WAIT_SEMAPHORE:
+        /* consumes the signal on behalf of the coroutine */
+        retval = semaphore_wait((struct semaphore *)self->object);
+        break;
+    case CORO_WAIT_TICKS:
+        retval = ((int32_t)(timer_get_time() - self->deadline) >= 0);
+        break;
+    }
+    
+    return retval;
+}
@@ -0,0 +1,124 @@
+/* Copyright (c) 2018 Cameron Harper
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * */
+
+#include "counter.h"
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <util/atomic.h>
+#include <stdbool.h>
+
+#ifndef F_CPU
+#   warning F_CPU defaults to 16000000UL
+#   define F_CPU 16000000UL
+#endif
+
+static volatile uint16_t overflow;
+static volatile enum counter_prescaler prescaler;
+
+/* functions **********************************************************/
+
+void counter_start(enum counter_prescaler div)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE){
+        
+        prescaler = div;
+        overflow = 0U;
+        
+        /* normal mode */
+        TCCR1A = 0U;
+        TCCR1B = (TCCR1B & ~(_BV(WGM13) | _BV(WGM12) | _BV(CS12) | _BV(CS11) | _BV(CS10))) | (uint8_t)div;
+        
+        TCNT1 = 0U;
+        
+        TIFR1 = _BV(TOV1);
+        TIMSK1 |= _BV(TOIE1);
+    }
+}
+
+void counter_stop(void)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE){
+        
+        TCCR1B &= ~(_BV(CS12) | _BV(CS11) | _BV(CS10));
+        TIMSK1 &= ~_BV(TOIE1);
+    }
+}
+
+uint32_t counter_get_time(void)
+{
+    uint32_t retval;
+    
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE){
+        
+        retval = counter_extend(TCNT1);
+    }
+    
+    return retval;
+}
+
+uint32_t counter_extend(uint16_t value)
+{
+    uint32_t retval = overflow;
+    
+    /* overflow is pending and value was read after it */
+    if(((TIFR1 & _BV(TOV1)) > 0U) && (value < 0x8000U)){
+        
+        retval++;
+    }
+    
+    retval <<= 16U;
+    retval |= value;
+    
+    return retval;
+}
+
+uint32_t counter_ticks_per_second(void)
+{
+    uint32_t retval = (F_CPU >> (CLKPR & 0xfU));
+    
+    switch(prescaler){
+    default:
+    case COUNTER_DIV_1:
+        break;
+    case COUNTER_DIV_8:
+        retval >>= 3U;
+        break;
+    case COUNTER_DIV_64:
+        retval >>= 6U;
+        break;
+    case COUNTER_DIV_256:
+        retval >>= 8U;
+        break;
+    case COUNTER_DIV_1024:
+        retval >>= 10U;
+        break;
+    }
+    
+    return retval;
+}
+
+/* isr ****************************************************************/
+
+ISR(TIMER1_OVF_vect)
+{
+    overflow++;
+}
@@ -0,0 +1,268 @@
+/* Copyright (c) 2018 Cameron Harper
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * */
+
+#include "debounce.h"
+#include "timer.h"
+
+#include <avr/io.h>
+#include <util/atomic.h>
+#include <stddef.h>
+
+static volatile uint8_t mask[PIN_PORT_MAX];
+static volatile uint8_t invert[PIN_PORT_MAX];
+static volatile uint8_t state[PIN_PORT_MAX];
+static volatile uint8_t cnt0[PIN_PORT_MAX];
+static volatile uint8_t cnt1[PIN_PORT_MAX];
+
+static volatile struct debounce_event events[DEBOUNCE_EVENT_SIZE];
+static volatile uint8_t head;
+static volatile uint8_t count;
+static volatile bool lost;
+
+static volatile struct timer_event tick;
+static volatile uint32_t tick_interval;
+static volatile bool ticking;
+
+/* static function prototypes *****************************************/
+
+static uint8_t read_port(enum pin_port port);
+static void sample_port(enum pin_port port, uint8_t raw);
+static void push_event(enum pin_id id, bool pressed);
+static void tick_handler(volatile struct timer_event *ev);
+
+/* functions **********************************************************/
+
+void debounce_add(enum pin_id id, bool active_low)
+{
+    if(id != PIN_NA){
+        
+        enum pin_port port = PIN_PORT(id);
+        uint8_t bit = _BV(PIN_BIT(id));
+        
+        pin_set(id, PIN_INPUT, active_low);
+        
+        ATOMIC_BLOCK(ATOMIC_RESTORESTATE){
+            
+            if(active_low){
+                
+                invert[port] |= bit;
+            }
+            else{
+                
+                invert[port] &= ~bit;
+            }
+            
+            state[port] = (state[port] & ~bit) | ((read_port(port) ^ invert[port]) & bit);
+            cnt0[port] |= bit;
+            cnt1[port] |= bit;
+            mask[port] |= bit;
+        }
+    }
+}
+
+void debounce_remove(enum pin_id id)
+{
+    if(id != PIN_NA){
+        
+        enum pin_port port = PIN_PORT(id);
+        uint8_t bit = _BV(PIN_BIT(id));
+        
+        ATOMIC_BLOCK(ATOMIC_RESTORESTATE){
+            
+            mask[port] &= ~bit;
+            state[port] &= ~bit;
+        }
+    }
+}
+
+void debounce_sample(void)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE){
+        
+        if(mask[PIN_PORT_D] > 0U){
+            
+            sample_port(PIN_PORT_D, PIND);
+        }
+        
+        if(mask[PIN_PORT_B] > 0U){
+            
+            sample_port(PIN_PORT_B, PINB);
+        }
+        
+        if(mask[PIN_PORT_C] > 0U){
+            
+            sample_port(PIN_PORT_C, PINC);
+        }
+    }
+}
+
+void debounce_start(uint32_t interval)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE){
+        
+        if(ticking){
+            
+            timer_clear(&tick);
+        }
+        
+        tick_interval = interval;
+        ticking = true;
+        timer_set(&tick, interval, tick_handler);
+    }
+}
+
+void debounce_stop(void)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE){
+        
+        if(ticking){
+            
+            timer_clear(&tick);
+            ticking = false;
+        }
+    }
+}
+
+bool debounce_get_event(struct debounce_event *ev)
+{
+    bool retval = false;
+    
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE){
+        
+        if(count > 0U){
+            
+            uint8_t tail = (uint8_t)((head + DEBOUNCE_EVENT_SIZE - count) % DEBOUNCE_EVENT_SIZE);
+            
+            ev->id = events[tail].id;
+            ev->pressed = events[tail].pressed;
+            
+            count--;
+            retval = true;
+        }
+    }
+    
+    return retval;
+}
+
+bool debounce_event_lost(void)
+{
+    bool retval;
+    
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE){
+        
+        retval = lost;
+        lost = false;
+    }
+    
+    return retval;
+}
+
+bool debounce_is_pressed(enum pin_id id)
+{
+    bool retval = false;
+    
+    if(id != PIN_NA){
+        
+        retval = ((state[PIN_PORT(id)] & _BV(PIN_BIT(id))) > 0U);
+    }
+    
+    return retval;
+}
+
+/* static functions ***************************************************/
+
+static uint8_t read_port(enum pin_port port)
+{
+    uint8_t retval;
+    
+    switch(port){
+    default:
+    case PIN_PORT_D:
+        retval = PIND;
+        break;
+    case PIN_PORT_B:
+        retval = PINB;
+        break;
+    case PIN_PORT_C:
+        retval = PINC;
+        break;
+    }
+    
+    return retval;
+}
+
+static void sample_port(enum pin_port port, uint8_t raw)
+{
+    /* one bit per pin, set if pressed */
+    uint8_t changed = state[port] ^ ((raw ^ invert[port]) & mask[port]);
+    uint8_t c0;
+    uint8_t c1;
+    
+    /* count down while changed, reset to 3 otherwise */
+    c0 = ~(cnt0[port] & changed);
+    c1 = c0 ^ (cnt1[port] & changed);
+    
+    cnt0[port] = c0;
+    cnt1[port] = c1;
+    
+    /* toggle on rollover */
+    changed &= c0 & c1;
+    
+    if(changed > 0U){
+        
+        uint8_t bit = 0U;
+        
+        state[port] ^= changed;
+        
+        while(changed > 0U){
+            
+            if((changed & 1U) > 0U){
+                
+                push_event(PIN_ID(port, bit), ((state[port] & _BV(bit)) > 0U));
+            }
+            
+            changed >>= 1U;
+            bit++;
+        }
+    }
+}
+
+static void push_event(enum pin_id id, bool pressed)
+{
+    if(count < DEBOUNCE_EVENT_SIZE){
+        
+        events[head].id = id;
+        events[head].pressed = pressed;
+        
+        head = (uint8_t)((head + 1U) % DEBOUNCE_EVENT_SIZE);
+        count++;
+    }
+    else{
+        
+        lost = true;
+    }
+}
+
+static void tick_handler(volatile struct timer_event *ev)
+{
+    debounce_sample();
+    timer_set(ev, tick_interval, tick_handler);
+}
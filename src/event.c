@@ -0,0 +1,145 @@
+/* Copyright (c) 2018 Cameron Harper
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * */
+
+#include "event.h"
+
+#include <avr/interrupt.h>
+#include <avr/sleep.h>
+#include <util/atomic.h>
+
+/* static function prototypes *****************************************/
+
+static void sleep(void);
+
+/* functions **********************************************************/
+
+void event_init(struct event_group *self)
+{
+    self->flags = 0U;
+}
+
+void event_set(struct event_group *self, event_flags_t mask)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE){
+        
+        self->flags |= mask;
+    }
+}
+
+void event_clear(struct event_group *self, event_flags_t mask)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE){
+        
+        self->flags &= ~mask;
+    }
+}
+
+event_flags_t event_peek(struct event_group *self)
+{
+    event_flags_t retval;
+    
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE){
+        
+        retval = self->flags;
+    }
+    
+    return retval;
+}
+
+event_flags_t event_wait_any(struct event_group *self, event_flags_t mask)
+{
+    event_flags_t retval;
+    
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE){
+        
+        retval = self->flags & mask;
+        self->flags &= ~retval;
+    }
+    
+    return retval;
+}
+
+bool event_wait_all(struct event_group *self, event_flags_t mask)
+{
+    bool retval = false;
+    
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE){
+        
+        if((self->flags & mask) == mask){
+            
+            self->flags &= ~mask;
+            retval = true;
+        }
+    }
+    
+    return retval;
+}
+
+event_flags_t event_sleep_any(struct event_group *self, event_flags_t mask)
+{
+    event_flags_t retval;
+    
+    for(;;){
+        
+        cli();
+        
+        retval = self->flags & mask;
+        
+        if(retval > 0U){
+            
+            self->flags &= ~retval;
+            sei();
+            break;
+        }
+        
+        sleep();
+    }
+    
+    return retval;
+}
+
+void event_sleep_all(struct event_group *self, event_flags_t mask)
+{
+    for(;;){
+        
+        cli();
+        
+        if((self->flags & mask) == mask){
+            
+            self->flags &= ~mask;
+            sei();
+            break;
+        }
+        
+        sleep();
+    }
+}
+
+/* static functions ***************************************************/
+
+/* call with interrupts disabled, returns with them enabled */
+static void sleep(void)
+{
+    sleep_enable();
+    sei();
+    sleep_cpu();
+    sleep_disable();
+}
@@ -0,0 +1,349 @@
+/* Copyright (c) 2018 Cameron Harper
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * */
+
+#include "flash.h"
+#include "spi.h"
+#include "timer.h"
+
+enum flash_command {
+    FLASH_CMD_WRITE_ENABLE = 0x06U,
+    FLASH_CMD_READ_STATUS = 0x05U,
+    FLASH_CMD_PAGE_PROGRAM = 0x02U,
+    FLASH_CMD_FAST_READ = 0x0BU,
+    FLASH_CMD_SECTOR_ERASE = 0x20U,
+    FLASH_CMD_JEDEC_ID = 0x9FU
+};
+
+/* status register write-in-progress bit */
+#define FLASH_STATUS_WIP 0x01U
+
+static enum pin_id cs = PIN_NA;
+static uint8_t cache[FLASH_PAGE_SIZE];
+static uint32_t cache_page;
+static uint16_t cache_start;
+static uint16_t cache_end;
+static bool flush;
+static bool busy;
+static bool streaming;
+static volatile bool poll_due;
+static volatile struct timer_event poll_timer;
+
+/* static function prototypes *****************************************/
+
+static void select(void);
+static void deselect(void);
+static void command(enum flash_command cmd, uint32_t addr);
+static void write_enable(void);
+static uint8_t read_status(void);
+static void start_poll(void);
+static void program_cache(void);
+static bool cache_ready(void);
+static void poll_handler(volatile struct timer_event *ev);
+
+/* functions **********************************************************/
+
+void flash_init(enum pin_id pin)
+{
+    cs = pin;
+    deselect();
+    
+    cache_page = 0U;
+    cache_start = 0U;
+    cache_end = 0U;
+    flush = false;
+    busy = false;
+    streaming = false;
+    poll_due = false;
+    
+    /* an earlier program or erase may still be running */
+    if((read_status() & FLASH_STATUS_WIP) > 0U){
+        
+        start_poll();
+    }
+}
+
+void flash_process(void)
+{
+    if(busy && poll_due){
+        
+        poll_due = false;
+        
+        if((read_status() & FLASH_STATUS_WIP) > 0U){
+            
+            start_poll();
+        }
+        else{
+            
+            busy = false;
+        }
+    }
+    
+    if(!busy && !streaming && cache_ready()){
+        
+        program_cache();
+    }
+}
+
+bool flash_busy(void)
+{
+    flash_process();
+    
+    return (busy || cache_ready());
+}
+
+bool flash_read_id(uint8_t *id)
+{
+    bool retval = false;
+    
+    flash_process();
+    
+    if(!busy && !streaming){
+        
+        select();
+        (void)spi_write(FLASH_CMD_JEDEC_ID);
+        id[0] = spi_write(0xffU);
+        id[1] = spi_write(0xffU);
+        id[2] = spi_write(0xffU);
+        deselect();
+        
+        retval = true;
+    }
+    
+    return retval;
+}
+
+bool flash_read(uint32_t addr, void *buf, size_t len)
+{
+    bool retval = false;
+    
+    if(flash_stream_open(addr)){
+        
+        flash_stream_read(buf, len);
+        flash_stream_close();
+        retval = true;
+    }
+    
+    return retval;
+}
+
+bool flash_stream_open(uint32_t addr)
+{
+    bool retval = false;
+    
+    flash_process();
+    
+    if(!busy && !streaming){
+        
+        select();
+        command(FLASH_CMD_FAST_READ, addr);
+        
+        /* dummy byte */
+        (void)spi_write(0xffU);
+        
+        streaming = true;
+        retval = true;
+    }
+    
+    return retval;
+}
+
+void flash_stream_read(void *buf, size_t len)
+{
+    uint8_t *ptr = buf;
+    size_t i;
+    
+    for(i=0U; i < len; i++){
+        
+        ptr[i] = spi_write(0xffU);
+    }
+}
+
+size_t flash_stream_read_fifo(volatile struct fifo *fifo, size_t len)
+{
+    size_t retval = 0U;
+    
+    while((retval < len) && !fifo_full(fifo)){
+        
+        (void)fifo_push(fifo, spi_write(0xffU));
+        retval++;
+    }
+    
+    return retval;
+}
+
+void flash_stream_close(void)
+{
+    deselect();
+    streaming = false;
+}
+
+bool flash_seek(uint32_t addr)
+{
+    bool retval = false;
+    
+    if(cache_start == cache_end){
+        
+        cache_page = addr & ~((uint32_t)FLASH_PAGE_SIZE - 1U);
+        cache_start = (uint16_t)(addr & (FLASH_PAGE_SIZE - 1U));
+        cache_end = cache_start;
+        flush = false;
+        retval = true;
+    }
+    
+    return retval;
+}
+
+size_t flash_append(const void *data, size_t len)
+{
+    const uint8_t *ptr = data;
+    size_t retval = 0U;
+    
+    flash_process();
+    
+    while((retval < len) && (cache_end < FLASH_PAGE_SIZE)){
+        
+        cache[cache_end] = ptr[retval];
+        cache_end++;
+        retval++;
+        
+        if(cache_end == FLASH_PAGE_SIZE){
+            
+            flash_process();
+        }
+    }
+    
+    return retval;
+}
+
+void flash_flush(void)
+{
+    flush = true;
+    flash_process();
+}
+
+bool flash_erase(uint32_t addr)
+{
+    bool retval = false;
+    
+    flash_process();
+    
+    if(!busy && !streaming){
+        
+        write_enable();
+        
+        select();
+        command(FLASH_CMD_SECTOR_ERASE, addr);
+        deselect();
+        
+        start_poll();
+        retval = true;
+    }
+    
+    return retval;
+}
+
+/* static functions ***************************************************/
+
+static void select(void)
+{
+    pin_set(cs, PIN_OUTPUT, false);
+}
+
+static void deselect(void)
+{
+    pin_set(cs, PIN_OUTPUT, true);
+}
+
+static void command(enum flash_command cmd, uint32_t addr)
+{
+    (void)spi_write((uint8_t)cmd);
+    (void)spi_write((uint8_t)(addr >> 16U));
+    (void)spi_write((uint8_t)(addr >> 8U));
+    (void)spi_write((uint8_t)addr);
+}
+
+static void write_enable(void)
+{
+    select();
+    (void)spi_write(FLASH_CMD_WRITE_ENABLE);
+    deselect();
+}
+
+static uint8_t read_status(void)
+{
+    uint8_t retval;
+    
+    select();
+    (void)spi_write(FLASH_CMD_READ_STATUS);
+    retval = spi_write(0xffU);
+    deselect();
+    
+    return retval;
+}
+
+static void start_poll(void)
+{
+    busy = true;
+    poll_due = false;
+    timer_set(&poll_timer, FLASH_POLL_INTERVAL, poll_handler);
+}
+
+static bool cache_ready(void)
+{
+    return ((cache_end == FLASH_PAGE_SIZE) || (flush && (cache_start < cache_end)));
+}
+
+static void program_cache(void)
+{
+    uint16_t i;
+    
+    write_enable();
+    
+    select();
+    command(FLASH_CMD_PAGE_PROGRAM, cache_page + cache_start);
+    
+    for(i=cache_start; i < cache_end; i++){
+        
+        (void)spi_write(cache[i]);
+    }
+    
+    deselect();
+    
+    start_poll();
+    
+    if(cache_end == FLASH_PAGE_SIZE){
+        
+        cache_page += FLASH_PAGE_SIZE;
+        cache_start = 0U;
+        cache_end = 0U;
+    }
+    else{
+        
+        cache_start = cache_end;
+    }
+    
+    flush = false;
+}
+
+static void poll_handler(volatile struct timer_event *ev)
+{
+    poll_due = true;
+}
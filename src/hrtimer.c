@@ -0,0 +1,279 @@
+/* Copyright (c) 2018 Cameron Harper
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * */
+
+#include "hrtimer.h"
+#include "counter.h"
+#include "timer.h"
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <util/atomic.h>
+#include <stddef.h>
+#include <assert.h>
+
+static volatile struct timer_event *volatile timers;
+static volatile bool busy;
+
+/* measured counter ticks per second */
+static volatile uint32_t rate;
+
+/* counter ticks per microsecond (Q16) */
+static volatile uint32_t scale;
+
+/* start of the current rate measurement */
+static struct timer_event discipline;
+static volatile bool have_sample;
+static volatile uint32_t sample_tick;
+static volatile uint32_t sample_count;
+static volatile uint32_t sample_nominal;
+
+/* static function prototypes *****************************************/
+
+static void hrtimer_link(volatile struct timer_event *self);
+static void hrtimer_unlink(volatile struct timer_event *self);
+static void process(void);
+static void discipline_handler(volatile struct timer_event *ev);
+static uint32_t rate_to_scale(uint32_t ticks_per_second);
+
+/* functions **********************************************************/
+
+void hrtimer_start(void)
+{
+    timer_clear(&discipline);
+    
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE){
+        
+        timers = NULL;
+        busy = false;
+        have_sample = false;
+        
+        rate = counter_ticks_per_second();
+        scale = rate_to_scale(rate);
+        
+        TIMSK1 &= ~_BV(OCIE1A);
+    }
+    
+    /* first sample is taken on a TC2 tick */
+    timer_set(&discipline, 1U, discipline_handler);
+}
+
+uint32_t hrtimer_get_time(void)
+{
+    return counter_get_time();
+}
+
+uint32_t hrtimer_ticks_per_second(void)
+{
+    uint32_t retval;
+    
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE){
+        
+        retval = rate;
+    }
+    
+    return retval;
+}
+
+uint32_t hrtimer_ticks(uint32_t us)
+{
+    uint32_t q;
+    
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE){
+        
+        q = scale;
+    }
+    
+    return (uint32_t)(((uint64_t)us * q) >> 16U);
+}
+
+void hrtimer_set(volatile struct timer_event *self, uint32_t us, timer_handle_fn handler)
+{
+    hrtimer_set_ticks(self, hrtimer_ticks(us), handler);
+}
+
+void hrtimer_set_ticks(volatile struct timer_event *self, uint32_t ticks, timer_handle_fn handler)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE){
+        
+        assert(self->prev == NULL);
+        
+        self->timeout = counter_get_time() + ticks;
+        self->handler = handler;
+        
+        hrtimer_link(self);
+        process();
+    }
+}
+
+void hrtimer_clear(volatile struct timer_event *self)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE){
+        
+        hrtimer_unlink(self);
+        
+        if(timers == NULL){
+            
+            TIMSK1 &= ~_BV(OCIE1A);
+        }
+    }
+}
+
+/* static functions ***************************************************/
+
+static void hrtimer_link(volatile struct timer_event *self)
+{
+    volatile struct timer_event *volatile *link = &timers;
+    
+    /* sorted by timeout, equal timeouts expire in order set */
+    while((*link != NULL) && ((int32_t)((*link)->timeout - self->timeout) <= 0)){
+        
+        link = &(*link)->next;
+    }
+    
+    self->next = *link;
+    self->prev = link;
+    
+    if(self->next != NULL){
+        
+        self->next->prev = &self->next;
+    }
+    
+    *link = self;
+}
+
+static void hrtimer_unlink(volatile struct timer_event *self)
+{
+    if((self->prev != NULL) && (*self->prev == self)){
+        
+        *self->prev = self->next;
+        
+        if(self->next != NULL){
+            
+            self->next->prev = self->prev;
+        }
+        
+        self->next = NULL;
+        self->prev = NULL;
+    }
+}
+
+/* call expired handlers and program OCR1A for the next timeout 
+ * 
+ * must be called with interrupts disabled
+ * 
+ * */
+static void process(void)
+{
+    /* handlers that set timers are picked up by the outer call */
+    if(!busy){
+        
+        busy = true;
+        
+        while(timers != NULL){
+            
+            volatile struct timer_event *ptr = timers;
+            uint32_t time = counter_get_time();
+            int32_t diff = (int32_t)(ptr->timeout - time);
+            
+            if(diff <= 0){
+                
+                hrtimer_unlink(ptr);
+                ptr->handler(ptr);
+            }
+            else{
+                
+                /* beyond one TC1 period: compare again after wrapping */
+                OCR1A = (diff <= 0xffffL) ? (uint16_t)ptr->timeout : (uint16_t)time;
+                
+                TIFR1 = _BV(OCF1A);
+                
+                /* counter may have passed OCR1A before it was written */
+                if((int32_t)(ptr->timeout - counter_get_time()) > 0){
+                    
+                    break;
+                }
+            }
+        }
+        
+        if(timers != NULL){
+            
+            TIMSK1 |= _BV(OCIE1A);
+        }
+        else{
+            
+            TIMSK1 &= ~_BV(OCIE1A);
+        }
+        
+        busy = false;
+    }
+}
+
+/* measure counter ticks between two TC2 ticks 
+ * 
+ * Called from the TC2 compare interrupt so both samples are close
+ * to a TC2 tick edge. Error from interrupt latency is spread over
+ * HRTIMER_DISCIPLINE_INTERVAL.
+ * 
+ * */
+static void discipline_handler(volatile struct timer_event *ev)
+{
+    uint32_t tick = timer_get_time();
+    uint32_t count = counter_get_time();
+    uint32_t nominal = counter_ticks_per_second();
+    
+    if(have_sample){
+        
+        /* clock or counter prescaler changed during the window */
+        if(nominal != sample_nominal){
+            
+            rate = nominal;
+        }
+        else{
+            
+            uint32_t elapsed = tick - sample_tick;
+            uint32_t ticks = count - sample_count;
+            
+            rate = ((ticks / elapsed) * TIMER_TICKS_PER_SECOND) + (((ticks % elapsed) * TIMER_TICKS_PER_SECOND) / elapsed);
+        }
+        
+        scale = rate_to_scale(rate);
+    }
+    
+    sample_tick = tick;
+    sample_count = count;
+    sample_nominal = nominal;
+    have_sample = true;
+    
+    timer_set(ev, HRTIMER_DISCIPLINE_INTERVAL, discipline_handler);
+}
+
+static uint32_t rate_to_scale(uint32_t ticks_per_second)
+{
+    /* (ticks_per_second << 16) / 1000000 without overflow */
+    return ((ticks_per_second / 15625UL) << 10U) + (((ticks_per_second % 15625UL) << 10U) / 15625UL);
+}
+
+/* isr ****************************************************************/
+
+ISR(TIMER1_COMPA_vect)
+{
+    process();
+}
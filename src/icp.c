@@ -0,0 +1,244 @@
+/* Copyright (c) 2018 Cameron Harper
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * */
+
+#include "icp.h"
+#include "counter.h"
+#include "pin.h"
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <util/atomic.h>
+
+static volatile enum icp_edge mode;
+static volatile struct icp_capture captures[ICP_BUFFER_SIZE];
+static volatile uint8_t head;
+static volatile uint8_t count;
+static volatile bool lost;
+
+static volatile uint32_t last_edge;
+static volatile uint32_t last_rise;
+static volatile bool have_edge;
+static volatile bool have_rise;
+static volatile uint32_t period;
+static volatile uint32_t high_time;
+
+/* static function prototypes *****************************************/
+
+static uint32_t read32(volatile const uint32_t *value);
+
+/* functions **********************************************************/
+
+void icp_start(enum icp_edge edge, bool noise_cancel)
+{
+    pin_set(PIN_D8, PIN_INPUT, false);
+    
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE){
+        
+        mode = edge;
+        head = 0U;
+        count = 0U;
+        lost = false;
+        have_edge = false;
+        have_rise = false;
+        period = 0U;
+        high_time = 0U;
+        
+        if(edge == ICP_FALLING){
+            
+            TCCR1B &= ~_BV(ICES1);
+        }
+        else{
+            
+            TCCR1B |= _BV(ICES1);
+        }
+        
+        if(noise_cancel){
+            
+            TCCR1B |= _BV(ICNC1);
+        }
+        else{
+            
+            TCCR1B &= ~_BV(ICNC1);
+        }
+        
+        /* changing edge can set the flag */
+        TIFR1 = _BV(ICF1);
+        TIMSK1 |= _BV(ICIE1);
+    }
+}
+
+void icp_stop(void)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE){
+        
+        TIMSK1 &= ~_BV(ICIE1);
+    }
+}
+
+bool icp_read(struct icp_capture *capture)
+{
+    bool retval = false;
+    
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE){
+        
+        if(count > 0U){
+            
+            uint8_t tail = (uint8_t)((head + ICP_BUFFER_SIZE - count) % ICP_BUFFER_SIZE);
+            
+            capture->time = captures[tail].time;
+            capture->level = captures[tail].level;
+            
+            count--;
+            retval = true;
+        }
+    }
+    
+    return retval;
+}
+
+bool icp_lost(void)
+{
+    bool retval;
+    
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE){
+        
+        retval = lost;
+        lost = false;
+    }
+    
+    return retval;
+}
+
+uint32_t icp_period(void)
+{
+    return read32(&period);
+}
+
+uint32_t icp_high_time(void)
+{
+    return read32(&high_time);
+}
+
+uint16_t icp_duty(void)
+{
+    uint32_t p;
+    uint32_t h;
+    uint16_t retval = 0U;
+    
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE){
+        
+        p = period;
+        h = high_time;
+    }
+    
+    if((p > 0U) && (h <= p)){
+        
+        retval = (uint16_t)(((uint64_t)h * 1000U) / p);
+    }
+    
+    return retval;
+}
+
+uint32_t icp_frequency(void)
+{
+    uint32_t p = read32(&period);
+    uint32_t retval = 0U;
+    
+    if(p > 0U){
+        
+        uint64_t mhz = ((uint64_t)counter_ticks_per_second() * 1000U) / p;
+        
+        /* saturate rather than wrap for periods shorter than the range */
+        retval = (mhz > UINT32_MAX) ? UINT32_MAX : (uint32_t)mhz;
+    }
+    
+    return retval;
+}
+
+/* static functions ***************************************************/
+
+static uint32_t read32(volatile const uint32_t *value)
+{
+    uint32_t retval;
+    
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE){
+        
+        retval = *value;
+    }
+    
+    return retval;
+}
+
+/* isr ****************************************************************/
+
+ISR(TIMER1_CAPT_vect)
+{
+    uint16_t icr = ICR1;
+    bool level = ((TCCR1B & _BV(ICES1)) > 0U);
+    uint32_t time = counter_extend(icr);
+    
+    if(mode == ICP_BOTH){
+        
+        TCCR1B ^= _BV(ICES1);
+        TIFR1 = _BV(ICF1);
+    }
+    
+    if(count < ICP_BUFFER_SIZE){
+        
+        captures[head].time = time;
+        captures[head].level = level;
+        
+        head = (uint8_t)((head + 1U) % ICP_BUFFER_SIZE);
+        count++;
+    }
+    else{
+        
+        lost = true;
+    }
+    
+    if(mode == ICP_BOTH){
+    
+        if(level){
+            
+            if(have_rise){
+                
+                period = time - last_rise;
+            }
+            
+            last_rise = time;
+            have_rise = true;
+        }
+        else if(have_rise){
+            
+            high_time = time - last_rise;
+        }
+    }
+    else{
+        
+        if(have_edge){
+            
+            period = time - last_edge;
+        }
+        
+        last_edge = time;
+        have_edge = true;
+    }
+}
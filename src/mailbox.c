@@ -0,0 +1,96 @@
+/* Copyright (c) 2018 Cameron Harper
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * */
+
+#include "mailbox.h"
+
+#include <util/atomic.h>
+
+void mailbox_init(struct mailbox *self, void *volatile *slots, size_t max)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE){
+        
+        self->slots = slots;
+        self->max = max;
+        self->size = 0U;
+        self->head = 0U;
+    }
+}
+
+bool mailbox_put(struct mailbox *self, void *msg)
+{
+    bool retval = false;
+    
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE){
+        
+        if(self->size < self->max){
+            
+            size_t tail = self->head + self->size;
+            
+            if(tail >= self->max){
+                
+                tail -= self->max;
+            }
+            
+            self->slots[tail] = msg;
+            self->size++;
+            retval = true;
+        }
+    }
+    
+    return retval;
+}
+
+bool mailbox_get(struct mailbox *self, void **msg)
+{
+    bool retval = false;
+    
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE){
+        
+        if(self->size > 0U){
+            
+            *msg = self->slots[self->head];
+            
+            self->head++;
+            
+            if(self->head == self->max){
+                
+                self->head = 0U;
+            }
+            
+            self->size--;
+            retval = true;
+        }
+    }
+    
+    return retval;
+}
+
+size_t mailbox_size(struct mailbox *self)
+{
+    size_t retval;
+    
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE){
+        
+        retval = self->size;
+    }
+    
+    return retval;
+}
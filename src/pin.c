@@ -21,20 +21,60 @@
 
 #include "pin.h"
 
+#ifdef PIN_EVENT
+#   include "counter.h"
+#endif
+
 #include <avr/io.h>
 #include <avr/interrupt.h>
 #include <util/atomic.h>
 #include <stdint.h>
 #include <stddef.h>
 
-static volatile struct pin_pcint *pcints;
+/* handlers for each pin indexed by port and bit */
+static volatile struct pin_pcint *pcints[PIN_PORT_MAX][8U];
+
+/* port state at the last pin change interrupt */
+static volatile uint8_t pcint_state[PIN_PORT_MAX];
+
+#ifdef PIN_EVENT
+
+/* pins that record events on each edge */
+static volatile uint8_t event_rising[PIN_PORT_MAX];
+static volatile uint8_t event_falling[PIN_PORT_MAX];
+
+/* event record FIFO */
+static volatile struct pin_event events[PIN_EVENT_SIZE];
+static volatile uint8_t event_head;
+static volatile uint8_t event_count;
+static volatile bool event_lost;
+
+/* TC1 is only sampled when events are recorded */
+#   define PCINT_ENTRY_TIME() TCNT1
+
+#else
+
+#   define PCINT_ENTRY_TIME() 0U
+
+#endif
+
+/* INT0 and INT1 handlers */
+static volatile pin_int_handler_t int_handlers[2U];
 
 /* static function prototypes *****************************************/
 
 static bool translate_pin(enum pin_id id, volatile uint8_t **state, volatile uint8_t **port, volatile uint8_t **ddr, volatile uint8_t **pcmsk, uint8_t *bit);
-static void unmask_pcint(enum pin_id id);
-static void mask_pcint(enum pin_id id);
+static bool translate_int(enum pin_id id, uint8_t *n);
+static volatile uint8_t *translate_pcint(enum pin_port port, uint8_t *pcie);
+static void update_pcint_mask(enum pin_port port, uint8_t bit);
+#ifdef PIN_EVENT
+static void record_events(enum pin_port port, uint8_t state, uint8_t changed, uint16_t now);
+#endif
+static void dispatch_pcint(enum pin_port port, uint8_t state, uint8_t pcmsk, uint16_t now);
 static void dummy_handler(void);
+static void translate_port(enum pin_port port, volatile uint8_t **state, volatile uint8_t **out, volatile uint8_t **ddr);
+static uint8_t group_to_port(const struct pin_group *self, enum pin_port port, uint16_t value);
+static uint16_t port_to_group(const struct pin_group *self, enum pin_port port, uint8_t value);
 
 /* functions **********************************************************/
 
@@ -85,109 +125,384 @@ void pin_set(enum pin_id id, enum pin_direction dir, bool on)
     }
 }
 
-void pin_set_pcint_handler(volatile struct pin_pcint *self, enum pin_id id, enum pin_pcint_mode mode, pin_pcint_handler_t handler)
-{    
-    ATOMIC_BLOCK(ATOMIC_RESTORESTATE){            
+void pin_toggle(enum pin_id id)
+{
+    volatile uint8_t *state;
+    volatile uint8_t *port;
+    volatile uint8_t *ddr;
+    volatile uint8_t *pcmsk;    
+    uint8_t bit;
+    
+    if(translate_pin(id, &state, &port, &ddr, &pcmsk, &bit)){
+        
+        /* writing one to PINx toggles PORTx */
+        *state = _BV(bit);
+    }
+}
 
-       volatile struct pin_pcint *ptr = pcints;
+bool pin_set_int_handler(enum pin_id id, enum pin_int_mode mode, pin_int_handler_t handler)
+{
+    bool retval = false;
+    uint8_t n;
+    
+    if(translate_int(id, &n)){
         
-        /* enable all the pin change interrupts */
-        PCICR |= _BV(PCIE0) |_BV(PCIE1) |_BV(PCIE2);
+        ATOMIC_BLOCK(ATOMIC_RESTORESTATE){
+            
+            EIMSK &= ~_BV(INT0 + n);
+            
+            EICRA = (EICRA & ~(3U << (n << 1U))) | ((uint8_t)mode << (n << 1U));
+            
+            int_handlers[n] = (handler == NULL) ? dummy_handler : handler;
+            
+            /* changing the sense may have raised the flag */
+            EIFR = _BV(INTF0 + n);
+            
+            EIMSK |= _BV(INT0 + n);
+        }
         
-        self->next = NULL;
+        retval = true;
+    }
+    
+    return retval;
+}
+
+void pin_clear_int_handler(enum pin_id id)
+{
+    uint8_t n;
+    
+    if(translate_int(id, &n)){
         
-        if(pcints == NULL){
+        ATOMIC_BLOCK(ATOMIC_RESTORESTATE){
             
-            pcints = self;        
+            EIMSK &= ~_BV(INT0 + n);
+            int_handlers[n] = dummy_handler;
         }
-        else{
+    }
+}
+
+bool pin_group_init(struct pin_group *self, const enum pin_id *ids, uint8_t size)
+{
+    bool retval = false;
+    uint8_t i;
+    
+    if(size <= PIN_GROUP_MAX){
+    
+        self->size = size;
+        
+        for(i=0U; i < PIN_PORT_MAX; i++){
             
-            while(ptr->next != NULL){
+            self->mask[i] = 0U;
+            self->shift[i] = 0;
+            self->linear[i] = true;
+        }
+        
+        for(i=0U; i < size; i++){
             
-                ptr = ptr->next;
+            enum pin_port port;
+            uint8_t bit;
+            int8_t shift;
+            
+            if(ids[i] == PIN_NA){
+                
+                /* no port bit will match */
+                self->member[i] = (uint8_t)(PIN_PORT_MAX << 3U);
+                continue;
             }
             
-            ptr->next = self;
+            port = PIN_PORT(ids[i]);
+            bit = PIN_BIT(ids[i]);
+            shift = (int8_t)bit - (int8_t)i;
+            
+            if(self->mask[port] == 0U){
+                
+                self->shift[port] = shift;
+            }
+            else if(self->shift[port] != shift){
+                
+                self->linear[port] = false;
+            }
+            
+            self->mask[port] |= _BV(bit);
+            self->member[i] = (uint8_t)((port << 3U) | bit);
         }
         
-        self->id = id;
-        self->state = pin_get(id);
-        self->handler = (handler == NULL) ? dummy_handler : handler;    
-        unmask_pcint(id);
+        retval = true;
     }
+    
+    return retval;
 }
 
-void pin_clear_pcint_handler(const struct pin_pcint *self)
-{    
-    ATOMIC_BLOCK(ATOMIC_RESTORESTATE){            
+void pin_group_direction(const struct pin_group *self, enum pin_direction dir)
+{
+    volatile uint8_t *state;
+    volatile uint8_t *port;
+    volatile uint8_t *ddr;
+    enum pin_port i;
     
-        volatile struct pin_pcint *ptr;
+    for(i=0U; i < PIN_PORT_MAX; i++){
         
-        if(pcints == self){
+        if(self->mask[i] > 0U){
+            
+            translate_port(i, &state, &port, &ddr);
             
-            pcints = pcints->next;
+            ATOMIC_BLOCK(ATOMIC_RESTORESTATE){
+                
+                if(dir == PIN_OUTPUT){
+                    
+                    *ddr |= self->mask[i];
+                }
+                else{
+                    
+                    *ddr &= ~self->mask[i];
+                }
+            }
         }
-        else{
+    }
+}
+
+uint16_t pin_group_get(const struct pin_group *self)
+{
+    volatile uint8_t *state;
+    volatile uint8_t *port;
+    volatile uint8_t *ddr;
+    uint16_t retval = 0U;
+    enum pin_port i;
+    
+    for(i=0U; i < PIN_PORT_MAX; i++){
+        
+        if(self->mask[i] > 0U){
             
-            ptr = pcints;
+            translate_port(i, &state, &port, &ddr);
             
-            while(ptr->next != NULL){
+            retval |= port_to_group(self, i, *state & self->mask[i]);
+        }
+    }
+    
+    return retval;
+}
+
+void pin_group_set(const struct pin_group *self, uint16_t value)
+{
+    volatile uint8_t *state;
+    volatile uint8_t *port;
+    volatile uint8_t *ddr;
+    enum pin_port i;
+    
+    for(i=0U; i < PIN_PORT_MAX; i++){
+        
+        if(self->mask[i] > 0U){
+            
+            uint8_t bits = group_to_port(self, i, value);
+            
+            translate_port(i, &state, &port, &ddr);
+            
+            ATOMIC_BLOCK(ATOMIC_RESTORESTATE){
                 
-                if(ptr->next == self){
-                    
-                    ptr->next = ptr->next->next;
-                    break;
-                }            
+                *port = (*port & ~self->mask[i]) | bits;
+            }
+        }
+    }
+}
+
+void pin_set_pcint_handler(volatile struct pin_pcint *self, enum pin_id id, enum pin_pcint_mode mode, pin_pcint_handler_t handler)
+{    
+    if(id != PIN_NA){
+        
+        enum pin_port port = PIN_PORT(id);
+        uint8_t bit = PIN_BIT(id);
+        
+        self->id = id;
+        self->mode = mode;
+        self->handler = (handler == NULL) ? dummy_handler : handler;    
+        self->next = NULL;
+        
+        ATOMIC_BLOCK(ATOMIC_RESTORESTATE){            
+
+            volatile struct pin_pcint *ptr = pcints[port][bit];
+            
+            if(ptr == NULL){
+                
+                pcints[port][bit] = self;
+                update_pcint_mask(port, bit);
+            }
+            else{
+                
+                while(ptr->next != NULL){
+                
+                    ptr = ptr->next;
+                }
+                
+                ptr->next = self;
             }
         }
+    }
+}
+
+void pin_clear_pcint_handler(const struct pin_pcint *self)
+{    
+    if(self->id != PIN_NA){
         
-        ptr = pcints;
+        enum pin_port port = PIN_PORT(self->id);
+        uint8_t bit = PIN_BIT(self->id);
         
-        while(ptr != NULL){
+        ATOMIC_BLOCK(ATOMIC_RESTORESTATE){            
+        
+            volatile struct pin_pcint *ptr = pcints[port][bit];
             
-            if(ptr->id == self->id){
+            if(ptr == self){
                 
-                break;
+                pcints[port][bit] = ptr->next;
+            }
+            else{
+                
+                while(ptr != NULL){
+                    
+                    if(ptr->next == self){
+                        
+                        ptr->next = self->next;
+                        break;
+                    }            
+                    
+                    ptr = ptr->next;
+                }
             }
             
-            ptr = ptr->next;
+            update_pcint_mask(port, bit);
         }
+    }
+}
+
+#ifdef PIN_EVENT
+
+void pin_set_pcint_event(enum pin_id id, enum pin_pcint_mode mode)
+{
+    if(id != PIN_NA){
         
-        if(ptr == NULL){
+        enum pin_port port = PIN_PORT(id);
+        uint8_t bit = PIN_BIT(id);
+        
+        ATOMIC_BLOCK(ATOMIC_RESTORESTATE){
+            
+            if(mode == PIN_FALLING){
+                
+                event_rising[port] &= ~_BV(bit);
+            }
+            else{
+                
+                event_rising[port] |= _BV(bit);
+            }
+            
+            if(mode == PIN_RISING){
+                
+                event_falling[port] &= ~_BV(bit);
+            }
+            else{
+                
+                event_falling[port] |= _BV(bit);
+            }
             
-            mask_pcint(self->id);
+            update_pcint_mask(port, bit);
         }
     }
 }
 
-/* static functions ***************************************************/
+void pin_clear_pcint_event(enum pin_id id)
+{
+    if(id != PIN_NA){
+        
+        enum pin_port port = PIN_PORT(id);
+        uint8_t bit = PIN_BIT(id);
+        
+        ATOMIC_BLOCK(ATOMIC_RESTORESTATE){
+            
+            event_rising[port] &= ~_BV(bit);
+            event_falling[port] &= ~_BV(bit);
+            
+            update_pcint_mask(port, bit);
+        }
+    }
+}
 
-static void unmask_pcint(enum pin_id id)
+bool pin_get_event(struct pin_event *ev)
 {
-    volatile uint8_t *state;
-    volatile uint8_t *port;
-    volatile uint8_t *ddr;
-    volatile uint8_t *pcmsk;    
-    uint8_t bit;
+    bool retval = false;
     
-    if(translate_pin(id, &state, &port, &ddr, &pcmsk, &bit)){
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE){
         
-       *pcmsk |= _BV(bit);
-    }    
+        if(event_count > 0U){
+            
+            uint8_t tail = (uint8_t)((event_head + PIN_EVENT_SIZE - event_count) % PIN_EVENT_SIZE);
+            
+            ev->id = events[tail].id;
+            ev->level = events[tail].level;
+            ev->time = events[tail].time;
+            
+            event_count--;
+            retval = true;
+        }
+    }
+    
+    return retval;
 }
 
-static void mask_pcint(enum pin_id id)
+bool pin_event_lost(void)
 {
-    volatile uint8_t *state;
-    volatile uint8_t *port;
-    volatile uint8_t *ddr;
-    volatile uint8_t *pcmsk;    
-    uint8_t bit;
+    bool retval;
     
-    if(translate_pin(id, &state, &port, &ddr, &pcmsk, &bit)){
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE){
         
-       *pcmsk &= ~_BV(bit);
-    }    
+        retval = event_lost;
+        event_lost = false;
+    }
+    
+    return retval;
+}
+
+#endif
+
+/* static functions ***************************************************/
+
+static bool translate_int(enum pin_id id, uint8_t *n)
+{
+    bool retval = true;
+    
+    switch(id){
+    case PIN_D2:
+        *n = 0U;
+        break;
+    case PIN_D3:
+        *n = 1U;
+        break;
+    default:
+        retval = false;
+        break;
+    }
+    
+    return retval;
+}
+
+static volatile uint8_t *translate_pcint(enum pin_port port, uint8_t *pcie)
+{
+    volatile uint8_t *retval;
+    
+    switch(port){
+    default:
+    case PIN_PORT_D:
+        *pcie = PCIE2;
+        retval = &(PCMSK2);
+        break;
+    case PIN_PORT_B:
+        *pcie = PCIE0;
+        retval = &(PCMSK0);
+        break;
+    case PIN_PORT_C:
+        *pcie = PCIE1;
+        retval = &(PCMSK1);
+        break;
+    }
+    
+    return retval;
 }
 
 static bool translate_pin(enum pin_id id, volatile uint8_t **state, volatile uint8_t **port, volatile uint8_t **ddr, volatile uint8_t **pcmsk, uint8_t *bit)
@@ -227,51 +542,238 @@ static bool translate_pin(enum pin_id id, volatile uint8_t **state, volatile uin
     return retval;
 }
 
-ISR(PCINT0_vect)
+static void translate_port(enum pin_port port, volatile uint8_t **state, volatile uint8_t **out, volatile uint8_t **ddr)
 {
-    volatile struct pin_pcint *ptr = pcints;
-    
-    while(ptr != NULL){
+    switch(port){
+    default:
+    case PIN_PORT_D:
+        *state = &(PIND);
+        *out = &(PORTD);
+        *ddr = &(DDRD);
+        break;
+    case PIN_PORT_B:
+        *state = &(PINB);
+        *out = &(PORTB);
+        *ddr = &(DDRB);
+        break;
+    case PIN_PORT_C:
+        *state = &(PINC);
+        *out = &(PORTC);
+        *ddr = &(DDRC);
+        break;
+    }
+}
+
+static uint8_t group_to_port(const struct pin_group *self, enum pin_port port, uint16_t value)
+{
+    uint8_t retval = 0U;
+    uint8_t i;
     
-        bool state = pin_get(ptr->id);        
+    if(self->linear[port]){
         
-        switch(ptr->mode){
-        case PIN_FALLING:
+        if(self->shift[port] >= 0){
+            
+            retval = (uint8_t)(value << self->shift[port]);
+        }
+        else{
+            
+            retval = (uint8_t)(value >> -self->shift[port]);
+        }
+        
+        retval &= self->mask[port];
+    }
+    else{
         
-            if(!state && ptr->state){
+        for(i=0U; i < self->size; i++){
+            
+            if(((self->member[i] >> 3U) == port) && ((value & (1U << i)) > 0U)){
                 
-                ptr->handler();
+                retval |= _BV(self->member[i] & 7U);
             }
-            break;
+        }
+    }
+    
+    return retval;
+}
+
+static uint16_t port_to_group(const struct pin_group *self, enum pin_port port, uint8_t value)
+{
+    uint16_t retval = 0U;
+    uint8_t i;
+    
+    if(self->linear[port]){
         
-        case PIN_RISING:
+        if(self->shift[port] >= 0){
+            
+            retval = (uint16_t)value >> self->shift[port];
+        }
+        else{
+            
+            retval = (uint16_t)value << -self->shift[port];
+        }
+    }
+    else{
         
-            if(state && !ptr->state){
+        for(i=0U; i < self->size; i++){
+            
+            if(((self->member[i] >> 3U) == port) && ((value & _BV(self->member[i] & 7U)) > 0U)){
                 
-                ptr->handler();
+                retval |= (1U << i);
             }
-            break;
+        }
+    }
+    
+    return retval;
+}
+
+static void update_pcint_mask(enum pin_port port, uint8_t bit)
+{
+    uint8_t pcie;
+    volatile uint8_t *pcmsk = translate_pcint(port, &pcie);
+    bool enable = (pcints[port][bit] != NULL);
+    
+#ifdef PIN_EVENT
+    enable = enable || (((event_rising[port] | event_falling[port]) & _BV(bit)) > 0U);
+#endif
+    
+    if(enable){
         
-        case PIN_CHANGE:
+        if((*pcmsk & _BV(bit)) == 0U){
+            
+            volatile uint8_t *state;
+            volatile uint8_t *out;
+            volatile uint8_t *ddr;
+            
+            translate_port(port, &state, &out, &ddr);
+            
+            /* edges are detected relative to this state */
+            pcint_state[port] = (pcint_state[port] & ~_BV(bit)) | (*state & _BV(bit));
+            
+            *pcmsk |= _BV(bit);
+            PCICR |= _BV(pcie);
+        }
+    }
+    else{
+        
+        *pcmsk &= ~_BV(bit);
+        
+        if(*pcmsk == 0U){
+            
+            PCICR &= ~_BV(pcie);
+        }
+    }
+}
+
+#ifdef PIN_EVENT
+
+static void record_events(enum pin_port port, uint8_t state, uint8_t changed, uint16_t now)
+{
+    uint32_t time = counter_extend(now);
+    uint8_t bit = 0U;
+    
+    while(changed > 0U){
         
-            if(state != ptr->state){
+        if((changed & 1U) > 0U){
+            
+            if(event_count < PIN_EVENT_SIZE){
+                
+                events[event_head].id = PIN_ID(port, bit);
+                events[event_head].level = ((state & _BV(bit)) > 0U);
+                events[event_head].time = time;
                 
-                ptr->handler();
+                event_head = (uint8_t)((event_head + 1U) % PIN_EVENT_SIZE);
+                event_count++;
             }
-            break;
+            else{
+                
+                event_lost = true;
+            }
+        }
+        
+        changed >>= 1U;
+        bit++;
+    }
+}
+
+#endif
+
+static void dispatch_pcint(enum pin_port port, uint8_t state, uint8_t pcmsk, uint16_t now)
+{
+    uint8_t changed = (state ^ pcint_state[port]) & pcmsk;
+    uint8_t bit = 0U;
+    
+    pcint_state[port] = state;
+    
+#ifdef PIN_EVENT
+    uint8_t recorded = changed & ((state & event_rising[port]) | (~state & event_falling[port]));
+    
+    if(recorded > 0U){
         
-        default:
-            break;
-        }        
+        record_events(port, state, recorded, now);
+    }
+#else
+    (void)now;
+#endif
     
-        ptr->state = state;
+    while(changed > 0U){
         
-        ptr = ptr->next;
-    }    
+        if((changed & 1U) > 0U){
+            
+            volatile struct pin_pcint *ptr = pcints[port][bit];
+            bool level = ((state & _BV(bit)) > 0U);
+            
+            while(ptr != NULL){
+                
+                if((ptr->mode == PIN_CHANGE) || ((ptr->mode == PIN_RISING) == level)){
+                    
+                    ptr->handler();
+                }
+                
+                ptr = ptr->next;
+            }
+        }
+        
+        changed >>= 1U;
+        bit++;
+    }
 }
 
-ISR(PCINT1_vect, ISR_ALIASOF(PCINT0_vect));
-ISR(PCINT2_vect, ISR_ALIASOF(PCINT0_vect));
+ISR(PCINT0_vect)
+{
+    /* snapshot at entry */
+    uint8_t state = PINB;
+    uint16_t now = PCINT_ENTRY_TIME();
+    
+    dispatch_pcint(PIN_PORT_B, state, PCMSK0, now);
+}
+
+ISR(PCINT1_vect)
+{
+    /* snapshot at entry */
+    uint8_t state = PINC;
+    uint16_t now = PCINT_ENTRY_TIME();
+    
+    dispatch_pcint(PIN_PORT_C, state, PCMSK1, now);
+}
+
+ISR(PCINT2_vect)
+{
+    /* snapshot at entry */
+    uint8_t state = PIND;
+    uint16_t now = PCINT_ENTRY_TIME();
+    
+    dispatch_pcint(PIN_PORT_D, state, PCMSK2, now);
+}
+
+ISR(INT0_vect)
+{
+    int_handlers[0U]();
+}
+
+ISR(INT1_vect)
+{
+    int_handlers[1U]();
+}
 
 static void dummy_handler(void)
 {
@@ -0,0 +1,85 @@
+/* Copyright (c) 2018 Cameron Harper
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * */
+
+#include "pool.h"
+
+#include <util/atomic.h>
+
+void pool_init(struct pool *self, void *buffer, size_t block_size, size_t blocks)
+{
+    uint8_t *block = (uint8_t *)buffer;
+    size_t i;
+    
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE){
+        
+        self->free = NULL;
+        self->count = 0U;
+    }
+    
+    /* link in reverse so the first allocation is the first block */
+    for(i=blocks; i > 0U; i--){
+        
+        pool_free(self, &block[(i - 1U) * block_size]);
+    }
+}
+
+void *pool_alloc(struct pool *self)
+{
+    void *retval;
+    
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE){
+        
+        retval = self->free;
+        
+        if(retval != NULL){
+            
+            self->free = *(void **)retval;
+            self->count--;
+        }
+    }
+    
+    return retval;
+}
+
+void pool_free(struct pool *self, void *block)
+{
+    if(block != NULL){
+        
+        ATOMIC_BLOCK(ATOMIC_RESTORESTATE){
+            
+            *(void **)block = self->free;
+            self->free = block;
+            self->count++;
+        }
+    }
+}
+
+size_t pool_available(struct pool *self)
+{
+    size_t retval;
+    
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE){
+        
+        retval = self->count;
+    }
+    
+    return retval;
+}
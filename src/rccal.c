@@ -20,30 +20,59 @@
  * */
 
 #include "rccal.h"
+#include "counter.h"
 
 #include <avr/io.h>
 #include <avr/interrupt.h>
 #include <util/atomic.h>
 #include <avr/boot.h>
 
+#ifndef F_CPU
+#   warning F_CPU defaults to 16000000UL
+#   define F_CPU 16000000UL
+#endif
+
+/* 32768Hz / 1024 */
+#define T2_TICKS_PER_SECOND 32UL
+
 enum rccal_state {
     RCCAL_STATE_OFF,     
     RCCAL_STATE_START,   
-    RCCAL_STATE_SETUP,   
-    RCCAL_STATE_HANDLE        
+    RCCAL_STATE_SEARCH,
+    RCCAL_STATE_TRACK_START,
+    RCCAL_STATE_TRACK
 };
 
 static volatile enum rccal_state state = RCCAL_STATE_OFF;
 static volatile enum rccal_result result;
-static volatile uint32_t ovf_counter;
+static volatile uint32_t stamp;
 static volatile uint32_t measure;
+static volatile uint8_t window;
 static volatile uint8_t step_size;
 static volatile uint8_t ncount;
+static volatile uint8_t track_interval;
+
+/* requested io clock (0 for nominal) */
+static volatile uint32_t target_hz;
+
+/* counter ticks per TC2 tick and allowed error */
+static volatile uint32_t target;
+static volatile uint32_t tolerance;
 
 /* prototypes *********************************************************/
 
 static uint32_t min_ticks(void);
 static uint32_t max_ticks(void);
+static uint32_t track_min_ticks(void);
+static uint32_t track_max_ticks(void);
+static uint32_t track_floor_ticks(void);
+static void search(void);
+static void track(void);
+static void finish(void);
+static void next_window(void);
+static void restart_window(void);
+static void set_target(void);
+static uint32_t nominal_hz(void);
 
 /* functions **********************************************************/
 
@@ -59,21 +88,103 @@ uint32_t rccal_measurement(void)
     return retval;
 }
 
+void rccal_set_target(uint32_t hz)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE){
+        
+        target_hz = hz;
+        set_target();
+    }
+}
+
+uint32_t rccal_baud_target(uint32_t baud)
+{
+    uint32_t nominal = nominal_hz();
+    uint32_t retval = nominal;
+    
+    if(baud > 0U){
+        
+        /* same UBRR0 and U2X0 choice as uart_init() makes at the nominal clock */
+        uint32_t setting1 = (nominal / (16UL * baud)) - 1U;
+        uint32_t setting2 = (nominal / (8UL * baud)) - 1U;
+        uint32_t baud1 = nominal / (16UL * (setting1 + 1U));
+        uint32_t baud2 = nominal / (8UL * (setting2 + 1U));
+        uint32_t error1 = (baud1 > baud) ? (baud1 - baud) : (baud - baud1);
+        uint32_t error2 = (baud2 > baud) ? (baud2 - baud) : (baud - baud2);
+        
+        /* io clock that makes that setting exact */
+        if(error2 < error1){
+            
+            retval = 8UL * baud * (setting2 + 1U);
+        }
+        else{
+            
+            retval = 16UL * baud * (setting1 + 1U);
+        }
+    }
+    
+    return retval;
+}
+
 void rccal_start(void)
 {
     ATOMIC_BLOCK(ATOMIC_RESTORESTATE){
     
+        set_target();
+        
         result = RCCAL_RESULT_NA;
         state = RCCAL_STATE_START;
      
         while((ASSR & _BV(OCR2BUB)) > 0);
-        OCR2B = TCNT2 + 3U;                
+        OCR2B = TCNT2 + 2U;                
         
         TIFR2 = _BV(OCF2B);
         TIMSK2 |= _BV(OCIE2B);   
     }
 }
 
+void rccal_track_start(uint8_t interval)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE){
+        
+        track_interval = (interval < 1U) ? 1U : interval;
+        
+        /* otherwise tracking starts when calibration finishes */
+        if(state == RCCAL_STATE_OFF){
+            
+            set_target();
+            
+            state = RCCAL_STATE_TRACK_START;
+            
+            while((ASSR & _BV(OCR2BUB)) > 0);
+            OCR2B = TCNT2 + 2U;
+            
+            TIFR2 = _BV(OCF2B);
+            TIMSK2 |= _BV(OCIE2B);
+        }
+    }
+}
+
+void rccal_track_stop(void)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE){
+        
+        track_interval = 0U;
+        
+        if((state == RCCAL_STATE_TRACK_START) || (state == RCCAL_STATE_TRACK)){
+            
+            TIMSK2 &= ~_BV(OCIE2B);
+            
+            state = RCCAL_STATE_OFF;
+        }
+    }
+}
+
+bool rccal_is_tracking(void)
+{
+    return (track_interval > 0U);
+}
+
 bool rccal_is_active(void)
 {
     return (result == RCCAL_RESULT_NA);
@@ -88,128 +199,249 @@ enum rccal_result rccal_get_result(void)
 
 static uint32_t min_ticks(void)
 {
-    return 125000UL - 1250UL;
+    return (target - tolerance) * window;
 }
 
 static uint32_t max_ticks(void)
 {
-    return 125000UL + 1250UL;
+    return (target + tolerance) * window;
 }
 
-/* isr ****************************************************************/
+static uint32_t track_min_ticks(void)
+{
+    return (target - (tolerance / 2UL)) * window;
+}
 
-ISR(TIMER0_OVF_vect)
-{        
-    ovf_counter++;
+static uint32_t track_max_ticks(void)
+{
+    return (target + (tolerance / 2UL)) * window;
 }
 
-ISR(TIMER2_COMPB_vect)
-{        
-    if(state == RCCAL_STATE_START){
+/* TC1 stops in power-save (clkIO is off) so a window that spans a sleep
+ * reads short, one step at a time tracking cannot have made the 
+ * oscillator half as fast so anything shorter than this is discarded */
+static uint32_t track_floor_ticks(void)
+{
+    return (target * window) / 2UL;
+}
+
+static uint32_t nominal_hz(void)
+{
+    return (F_CPU >> (CLKPR & 0xfU));
+}
+
+/* work out the measurement window limits once rather than per measurement */
+static void set_target(void)
+{
+    uint32_t hz = (target_hz > 0U) ? target_hz : nominal_hz();
+    
+    target = hz / T2_TICKS_PER_SECOND;
+    tolerance = (uint32_t)(((uint64_t)target * RCCAL_TOLERANCE_PPM) / 1000000UL);
+    
+    /* at least the resolution of one measurement */
+    if(tolerance == 0U){
         
-        step_size = (UINT8_MAX >> 1U);        
-        OSCCAL = step_size;
-        state = RCCAL_STATE_SETUP;        
+        tolerance = 1U;
     }
+}
+
+/* the window that started at the edge ran at the old OSCCAL until now,
+ * start it again so it is measured at the new setting only 
+ * 
+ * The restarted window is short by the cycles from entry to here. 
+ * These come before the OCR2B busy wait so they are a small constant
+ * compared with the 250000 cycles in one TC2 tick at 8MHz.
+ * 
+ * */
+static void restart_window(void)
+{
+    stamp = counter_get_time();
+}
+
+/* one tick resolves a step at any tolerance OSCCAL can achieve, only 
+ * the last binary search step uses a longer window to average out 
+ * interrupt latency */
+static void next_window(void)
+{
+    window = (step_size == 1U) ? RCCAL_FINE_WINDOW : 1U;
+}
+
+static void search(void)
+{
+    /* halve step size */
+    step_size >>= 1U;
     
-    switch(state){  
-    case RCCAL_STATE_SETUP:
-        
-        TCCR0B = _BV(CS00);        
-        TCNT0 = 0U;
-        TIMSK0 |= _BV(TOIE0);
-        
-        ovf_counter = 0U;     
-        ncount = 0U;       
-        
-        state = RCCAL_STATE_HANDLE;
-        
-        while((ASSR & _BV(OCR2BUB)) > 0);
-        OCR2B++;        
-        break;
+    /* calibration success */
+    if((measure >= min_ticks()) && (measure <= max_ticks())){
         
-    case RCCAL_STATE_HANDLE:
-    
-        /* halt TC0 and don't interrupt */
-        TCCR0B &= ~_BV(CS00);
-        TIMSK0 &= ~_BV(TOIE0);                
-        
-        /* capture measurement and compensate for unhandled overflow */
-        measure = ovf_counter;
-        measure <<= 8U;
-        measure += TCNT0;        
-        measure += ((TIFR0 & _BV(TOV0)) > 0) ? 0x100U : 0U;
-    
-        /* halve step size */
-        step_size >>= 1U;
+        result = RCCAL_RESULT_PASS;
+        finish();
+    }   
+    /* in progress */     
+    else if((step_size > 0U) || (ncount < 5U)){
         
-        /* calibration success */
-        if((measure >= min_ticks()) && (measure <= max_ticks())){
-            
-            result = RCCAL_RESULT_PASS;
-            state = RCCAL_STATE_OFF;
-            TIMSK2 &= ~_BV(OCIE2B);             
-        }   
-        /* in progress */     
-        else if((step_size > 0U) || (ncount < 5U)){
+        if(step_size > 0U){
             
-            if(step_size > 0U){
+            if(measure < min_ticks()){                    
                 
-                if(measure < min_ticks()){                    
-                    
-                    OSCCAL += step_size;
-                }
-                else{                
-                    
-                    OSCCAL -= step_size;
-                }                
+                OSCCAL += step_size;
             }
-            /* check 4 nearest neighbours (lazily re-check what we already have) */
-            else{
-            
-                if(ncount == 0U){
-                    
-                    if(OSCCAL < 2U){
-                    
-                        OSCCAL = 0U;
-                    }    
-                    else if(OSCCAL > 253U){
-                               
-                        OSCCAL = 250U;
-                    }
-                    else{
-                        
-                        OSCCAL -= 2U;
-                    } 
+            else{                
+                
+                OSCCAL -= step_size;
+            }                
+        }
+        /* check 4 nearest neighbours (lazily re-check what we already have) */
+        else{
+        
+            if(ncount == 0U){
+                
+                if(OSCCAL < 2U){
+                
+                    OSCCAL = 0U;
+                }    
+                else if(OSCCAL > 253U){
+                           
+                    OSCCAL = 250U;
                 }
                 else{
-                                    
-                    OSCCAL++;                
-                }   
-                
-                ncount++;         
+                    
+                    OSCCAL -= 2U;
+                } 
             }
+            else{
+                                
+                OSCCAL++;                
+            }   
             
-            /* measure again */
-            while((ASSR & _BV(OCR2BUB)) > 0);
-            OCR2B += 2U;            
-            state = RCCAL_STATE_SETUP;                        
+            ncount++;         
         }
-        /* calibration failure */
-        else{
+        
+        restart_window();
+        
+        /* measure again */
+        next_window();
+        
+        while((ASSR & _BV(OCR2BUB)) > 0);
+        OCR2B += window;
+    }
+    /* calibration failure */
+    else{
+        
+        /* restore the factory calibration */
+        OSCCAL = boot_signature_byte_get(1U);
+        restart_window();
+        
+        result = RCCAL_RESULT_FAIL;
+        finish();
+    }
+}
+
+static void track(void)
+{
+    /* window spanned a sleep */
+    if(measure < track_floor_ticks()){
+        
+        /* discard */
+    }
+    /* nudge without crossing between the two OSCCAL ranges */
+    else if(measure < track_min_ticks()){
+        
+        if((OSCCAL != 0x7fU) && (OSCCAL != 0xffU)){
             
-            /* restore the factory calibration */
-            OSCCAL = boot_signature_byte_get(1U);
+            OSCCAL++;
+            restart_window();
+        }
+    }
+    else if(measure > track_max_ticks()){
+        
+        if((OSCCAL != 0x00U) && (OSCCAL != 0x80U)){
             
-            result = RCCAL_RESULT_FAIL;
-            state = RCCAL_STATE_OFF;
-            TIMSK2 &= ~_BV(OCIE2B);
+            OSCCAL--;
+            restart_window();
         }
-        break;        
+    }
+    else{
+        
+        /* within threshold */
+    }
+    
+    while((ASSR & _BV(OCR2BUB)) > 0);
+    OCR2B += window;
+}
+
+/* calibration has finished, either stop or keep tracking */
+static void finish(void)
+{
+    if(track_interval > 0U){
+        
+        window = track_interval;
+        
+        while((ASSR & _BV(OCR2BUB)) > 0);
+        OCR2B += window;
+        
+        state = RCCAL_STATE_TRACK;
+    }
+    else{
+        
+        state = RCCAL_STATE_OFF;
+        TIMSK2 &= ~_BV(OCIE2B);
+    }
+}
+
+/* isr ****************************************************************/
+
+ISR(TIMER2_COMPB_vect)
+{        
+    /* timestamp as early as possible so that latency is constant */
+    uint16_t tc1 = TCNT1;
+    uint32_t now = counter_extend(tc1);
+    uint32_t start = stamp;
+    
+    /* each edge ends one window and starts the next (restarted if 
+     * OSCCAL changes) */
+    stamp = now;
+    
+    switch(state){  
+    case RCCAL_STATE_START:
+        
+        step_size = (UINT8_MAX >> 1U);        
+        OSCCAL = step_size;
+        restart_window();
+        ncount = 0U;
+        
+        next_window();
+        
+        while((ASSR & _BV(OCR2BUB)) > 0);
+        OCR2B += window;
+        
+        state = RCCAL_STATE_SEARCH;
+        break;
+        
+    case RCCAL_STATE_SEARCH:
+        
+        measure = now - start;
+        search();
+        break;
+        
+    case RCCAL_STATE_TRACK_START:
+        
+        window = track_interval;
+        
+        while((ASSR & _BV(OCR2BUB)) > 0);
+        OCR2B += window;
+        
+        state = RCCAL_STATE_TRACK;
+        break;
+        
+    case RCCAL_STATE_TRACK:
+        
+        measure = now - start;
+        track();
+        break;
         
     default:
     case RCCAL_STATE_OFF:
         break;
-    }    
+    }
 }
-
@@ -0,0 +1,136 @@
+/* Copyright (c) 2018 Cameron Harper
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * */
+
+#include "sched.h"
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/sleep.h>
+#include <util/atomic.h>
+#include <stddef.h>
+
+/* task table in flash */
+static const sched_handler_t *handlers;
+static volatile uint8_t posted[SCHED_TASKS];
+static volatile uint8_t ready;
+
+/* highest set bit of a nibble */
+static const uint8_t msb[16U] PROGMEM = {0U, 0U, 1U, 1U, 2U, 2U, 2U, 2U, 3U, 3U, 3U, 3U, 3U, 3U, 3U, 3U};
+
+/* static function prototypes *****************************************/
+
+static uint8_t highest(uint8_t mask);
+
+/* functions **********************************************************/
+
+void sched_init(const sched_handler_t *tasks)
+{
+    uint8_t i;
+    
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE){
+        
+        handlers = tasks;
+        
+        for(i=0U; i < SCHED_TASKS; i++){
+            
+            posted[i] = 0U;
+        }
+        
+        ready = 0U;
+    }
+}
+
+void sched_post(uint8_t priority, uint8_t events)
+{
+    if((priority < SCHED_TASKS) && (events > 0U)){
+        
+        ATOMIC_BLOCK(ATOMIC_RESTORESTATE){
+            
+            posted[priority] |= events;
+            ready |= _BV(priority);
+        }
+    }
+}
+
+bool sched_dispatch(void)
+{
+    bool retval = false;
+    sched_handler_t handler = NULL;
+    uint8_t pending = 0U;
+    
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE){
+        
+        if(ready > 0U){
+            
+            uint8_t priority = highest(ready);
+            
+            if(handlers != NULL){
+                
+                handler = (sched_handler_t)pgm_read_ptr(&handlers[priority]);
+            }
+            
+            pending = posted[priority];
+            
+            posted[priority] = 0U;
+            ready &= ~_BV(priority);
+            
+            retval = true;
+        }
+    }
+    
+    if(handler != NULL){
+        
+        handler(pending);
+    }
+    
+    return retval;
+}
+
+void sched_run(void)
+{
+    for(;;){
+        
+        if(!sched_dispatch()){
+            
+            cli();
+            
+            /* an interrupt may have posted since the dispatch */
+            if(ready == 0U){
+                
+                sleep_enable();
+                sei();
+                sleep_cpu();
+                sleep_disable();
+            }
+            else{
+                
+                sei();
+            }
+        }
+    }
+}
+
+/* static functions ***************************************************/
+
+static uint8_t highest(uint8_t mask)
+{
+    return ((mask & 0xf0U) > 0U) ? (4U + pgm_read_byte(&msb[mask >> 4U])) : pgm_read_byte(&msb[mask]);
+}
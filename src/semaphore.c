@@ -68,4 +68,42 @@ bool semaphore_peek(struct semaphore *self)
     return retval;
 }
 
+void semaphore_spsc_init(struct semaphore_spsc *self, uint8_t max)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE){
+        
+        self->max = max;
+        self->signalled = 0U;
+        self->taken = 0U;
+    }
+}
+
+void semaphore_spsc_signal(struct semaphore_spsc *self)
+{
+    uint8_t signalled = self->signalled;
+    
+    if((uint8_t)(signalled - self->taken) < self->max){
+        
+        self->signalled = signalled + 1U;
+    }
+}
+
+bool semaphore_spsc_wait(struct semaphore_spsc *self)
+{
+    bool retval = false;
+    uint8_t taken = self->taken;
+    
+    if(self->signalled != taken){
+        
+        self->taken = taken + 1U;
+        retval = true;
+    }
+    
+    return retval;
+}
+
+bool semaphore_spsc_peek(const struct semaphore_spsc *self)
+{
+    return (self->signalled != self->taken);
+}
 
@@ -31,15 +31,6 @@ void spi_init(enum spi_mode mode, enum spi_order order, uint32_t rate)
     uint32_t clock_setting;
     uint8_t clock_div;
     
-    /* atmega328: SCK (output) */
-    pin_set(PIN_D13, PIN_OUTPUT, false);
-    
-    /* atmega328: MISO (input, pullup) */
-    pin_set(PIN_D12, PIN_INPUT, true);
-    
-    /* atmega328: MOSI (output) */
-    pin_set(PIN_D11, PIN_OUTPUT, false);
-     
     clock_setting = (F_CPU >> (CLKPR & 0xfU)) >> 1U;
     clock_div = 0U;
             
@@ -56,12 +47,28 @@ void spi_init(enum spi_mode mode, enum spi_order order, uint32_t rate)
     
     clock_div ^= 1U;
     
-    SPCR = _BV(MSTR) | _BV(SPE) | 
+    spi_init_setting(
+        _BV(MSTR) | _BV(SPE) | 
         ((order == SPI_ORDER_LSB) ? _BV(DORD) : 0U) | 
         (uint8_t)mode |         
-        ((clock_div >> 1U) & 3U);
+        ((clock_div >> 1U) & 3U),
+        (clock_div & 1U)
+    );
+}
+
+void spi_init_setting(uint8_t spcr, uint8_t spsr)
+{
+    /* atmega328: SCK (output) */
+    pin_set(PIN_D13, PIN_OUTPUT, false);
+    
+    /* atmega328: MISO (input, pullup) */
+    pin_set(PIN_D12, PIN_INPUT, true);
+    
+    /* atmega328: MOSI (output) */
+    pin_set(PIN_D11, PIN_OUTPUT, false);
     
-    SPSR = (clock_div & 1U);    
+    SPCR = spcr;
+    SPSR = spsr;
 }
 
 uint8_t spi_write(uint8_t data)
@@ -23,35 +23,110 @@
 
 #include <avr/interrupt.h>
 #include <avr/io.h>
+#include <avr/sleep.h>
 #include <util/atomic.h>
 #include <stddef.h>
+#include <string.h>
 #include <stdbool.h>
 #include <assert.h>
 
-static volatile struct timer_event *timers;
+#ifdef TIMER_PROFILE
+#   include "counter.h"
+#endif
+
+#ifdef TIMER_WHEEL
+
+#define WHEEL_SLOTS (1U << TIMER_WHEEL_BITS)
+#define WHEEL_MASK (WHEEL_SLOTS - 1U)
+
+static volatile struct timer_event *volatile wheel[TIMER_WHEEL_LEVELS][WHEEL_SLOTS];
+
+/* next tick to be processed */
+static volatile uint32_t wheel_time;
+
+/* number of linked timers */
+static volatile uint16_t wheel_count;
+
+#else
+
+static volatile struct timer_event *volatile timers;
+
+#endif
+
+/* TC2 overflows (extended by time_high) */
 static volatile uint32_t time;
+static volatile uint8_t time_high;
+
+/* changed by every overflow so readers can detect a torn read */
+static volatile uint8_t sequence;
+
+/* set while in power-save, TCNT2 must be resynchronised before reading */
+static volatile bool sleeping;
+
+/* expired deferred timers */
+static volatile struct timer_event *volatile ready_head;
+static volatile struct timer_event *volatile ready_tail;
+
+#ifdef TIMER_PROFILE
+/* counter time on entry to the compare interrupt */
+static volatile uint32_t compare_entry;
+#endif
 
 /* static function prototypes *****************************************/
 
-static void timer_link(volatile struct timer_event **head, uint32_t time, volatile struct timer_event *self, uint32_t interval, timer_handle_fn handler);
-static void timer_unlink(volatile struct timer_event **head, volatile struct timer_event *self);
-static bool timer_already_linked(volatile struct timer_event *head, volatile struct timer_event *self);
-static int32_t timer_process(volatile struct timer_event **head, uint32_t time);
+static void timer_link(volatile struct timer_event *volatile *head, volatile struct timer_event *self);
+static void timer_unlink(volatile struct timer_event *self);
+static bool timer_already_linked(volatile struct timer_event *self);
+static void timer_arm(volatile struct timer_event *self, uint32_t interval, timer_handle_fn handler, bool once, bool deferred);
+static bool timer_queued(volatile struct timer_event *self);
+static void timer_dequeue(volatile struct timer_event *self);
+static void queue_init(uint32_t time);
+static void queue_insert(volatile struct timer_event *self, uint32_t time);
+static void queue_remove(volatile struct timer_event *self);
+static void queue_process(uint32_t time);
+static int32_t queue_next(uint32_t time);
+static void compare_set(int32_t diff);
+static void expire(volatile struct timer_event *self, uint32_t time);
+static void call(volatile struct timer_event *self);
+
+#ifdef TIMER_PROFILE
+static uint8_t bucket(uint32_t value);
+static void profile_late(volatile struct timer_event *self, uint32_t time);
+#endif
 static int32_t delta(uint32_t timeout, uint32_t time);
+static uint32_t align(uint32_t timeout, uint32_t slack);
+static uint8_t sample(uint32_t *count, uint8_t *high);
+static void wake_sync(void);
+
+#ifdef TIMER_WHEEL
+static void wheel_insert(volatile struct timer_event *self);
+static void wheel_cascade(uint8_t level, uint8_t slot);
+static void wheel_tick(uint32_t time);
+static int32_t wheel_next(void);
+#endif
 
 /* functions **********************************************************/
 
 uint32_t timer_interval(uint32_t t1, uint32_t t2)
 {
-    (uint32_t)delta(t1, t2);
+    return t2 - t1;
+}
+
+uint32_t timer_ms_to_ticks(uint32_t ms)
+{
+    /* rounded up so that a timeout is never early */
+    return ((ms / 1000U) * TIMER_TICKS_PER_SECOND) + ((((ms % 1000U) * TIMER_TICKS_PER_SECOND) + 999U) / 1000U);
+}
+
+uint64_t timer_ticks_to_ms(uint64_t ticks)
+{
+    return (ticks * 1000U) / TIMER_TICKS_PER_SECOND;
 }
 
 void timer_start(void)
 {
     ATOMIC_BLOCK(ATOMIC_RESTORESTATE){            
 
-        timers = NULL;
-    
         /* enable tosc */
         ASSR |= _BV(AS2);
         
@@ -68,194 +143,857 @@ void timer_start(void)
         while((ASSR & _BV(TCN2UB)) > 0);
         while((ASSR & _BV(OCR2AUB)) > 0);
         
+        queue_init(timer_get_time());
+        
+        ready_head = NULL;
+        ready_tail = NULL;
+        
         TIMSK2 |= _BV(TOIE2) | _BV(OCIE2A);
     }
 }
 
+void timer_init(volatile struct timer_event *self)
+{
+    self->next = NULL;
+    self->prev = NULL;
+    self->ready = NULL;
+    self->timeout = 0U;
+    self->expiry = 0U;
+    self->slack = 0U;
+    self->interval = 0U;
+    self->once = false;
+    self->deferred = false;
+#ifdef TIMER_PROFILE
+    self->profile = NULL;
+#endif
+    self->handler = NULL;
+}
+
 void timer_set(volatile struct timer_event *self, uint32_t interval, timer_handle_fn handler)
 {
-    ATOMIC_BLOCK(ATOMIC_RESTORESTATE){            
+    timer_arm(self, interval, handler, true, false);
+}
 
-        uint32_t time = timer_get_time();
+void timer_set_deferred(volatile struct timer_event *self, uint32_t interval, timer_handle_fn handler)
+{
+    timer_arm(self, interval, handler, true, true);
+}
+
+void timer_set_periodic(volatile struct timer_event *self, uint32_t interval, timer_handle_fn handler)
+{
+    assert(interval > 0U);
+    
+    timer_arm(self, interval, handler, false, false);
+}
 
-        assert(!timer_already_linked(timers, self));
-        timer_link(&timers, time, self, interval, handler);        
+uint32_t timer_next(void)
+{
+    int32_t retval;
+    
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE){
         
-        OCR2A = TCNT2 + 2U;
+        retval = queue_next(timer_get_time());
     }
+    
+    return (retval == INT32_MAX) ? UINT32_MAX : ((retval > 0) ? (uint32_t)retval : 0U);
 }
 
-void timer_clear(volatile struct timer_event *self)
+int32_t timer_sleep_until_next(void)
 {
-    ATOMIC_BLOCK(ATOMIC_RESTORESTATE){            
+    int32_t retval = 0;
+    uint32_t deadline;
+    int32_t diff;
+    
+    cli();
+    
+    deadline = timer_get_time();
+    diff = queue_next(deadline);
     
-        timer_unlink(&timers, self); 
+    /* deferred handlers waiting */
+    if(ready_head != NULL){
+        
+        sei();
     }
+    else{
+        
+        deadline += (uint32_t)diff;
+        
+        /* the write also makes sure a TOSC1 cycle has passed since 
+         * the last wakeup, otherwise the device may not wake again */
+        compare_set(diff);
+        while((ASSR & _BV(OCR2AUB)) > 0);
+        
+        /* whichever interrupt wakes the device resynchronises TCNT2 on its first read */
+        sleeping = true;
+        
+        set_sleep_mode(SLEEP_MODE_PWR_SAVE);
+        sleep_enable();
+        sei();
+        sleep_cpu();
+        sleep_disable();
+        
+        if(diff != INT32_MAX){
+            
+            retval = (int32_t)(timer_get_time() - deadline);
+        }
+    }
+    
+    return retval;
 }
 
-uint32_t timer_get_time(void)
+void timer_set_slack(volatile struct timer_event *self, uint32_t slack)
 {
-    uint32_t retval;
-    bool overflow;
-    uint8_t timer;
-    
     ATOMIC_BLOCK(ATOMIC_RESTORESTATE){
         
-        overflow = ((TIFR2 & _BV(TOV2)) > 0);
+        self->slack = slack;
+    }
+}
+
+#ifdef TIMER_PROFILE
+
+void timer_set_profile(volatile struct timer_event *self, struct timer_profile *profile)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE){
         
-        timer = TCNT2;
+        if(profile != NULL){
+            
+            (void)memset(profile, 0, sizeof(*profile));
+        }
+        
+        self->profile = profile;
+    }
+}
 
-        if(overflow || (((TIFR2 & _BV(TOV2)) > 0U) && (timer < (UINT8_MAX>>1U)))){
+void timer_get_profile(volatile const struct timer_event *self, struct timer_profile *profile)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE){
+        
+        if(self->profile != NULL){
             
-            retval = time + 1U;            
+            *profile = *self->profile;
         }
         else{
             
-            retval = time;
+            (void)memset(profile, 0, sizeof(*profile));
+        }
+    }
+}
+
+#endif
+
+void timer_clear(volatile struct timer_event *self)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE){            
+    
+        queue_remove(self); 
+        
+        if(timer_queued(self)){
+            
+            timer_dequeue(self);
+        }
+    }
+}
+
+bool timer_poll(void)
+{
+    return (ready_head != NULL);
+}
+
+void timer_dispatch(void)
+{
+    volatile struct timer_event *ptr;
+    
+    do{
+        
+        ATOMIC_BLOCK(ATOMIC_RESTORESTATE){
+            
+            ptr = ready_head;
+            
+            if(ptr != NULL){
+                
+                timer_dequeue(ptr);
+            }
+        }
+        
+        if(ptr != NULL){
+            
+            call(ptr);
         }
     }
+    while(ptr != NULL);
+}
 
+uint32_t timer_get_time(void)
+{
+    uint32_t retval;
+    uint8_t high;
+    uint8_t timer = sample(&retval, &high);
+    
     retval <<= 8U;        
     retval |= timer;
 
     return retval;
 }
 
+uint64_t timer_get_time64(void)
+{
+    uint32_t count;
+    uint8_t high;
+    uint8_t timer = sample(&count, &high);
+    uint64_t retval = ((uint64_t)high << 32U) | count;
+    
+    retval <<= 8U;
+    retval |= timer;
+    
+    return retval;
+}
+
 ISR(TIMER2_OVF_vect)
 {    
     time++;
+    
+    if(time == 0U){
+        
+        time_high++;
+    }
+    
+    sequence++;
 }
 
 ISR(TIMER2_COMPA_vect)
 {
-    int32_t diff = timer_process(&timers, timer_get_time());
+#ifdef TIMER_PROFILE
+    compare_entry = counter_get_time();
+#endif
+
+    uint32_t time = timer_get_time();
     
-    if(diff < 0xffU){
-             
-        if(diff < 2){
-         
-            diff = 2;
+    queue_process(time);
+    compare_set(queue_next(time));
+}
+    
+/* static functions ***************************************************/
+        
+static int32_t delta(uint32_t timeout, uint32_t time)
+{
+    return (int32_t)(timeout - time);
+}
+
+/* read the overflow count and TCNT2 without disabling interrupts
+ * 
+ * The read is repeated if an overflow interrupt ran part way through. 
+ * An overflow that is pending but not yet serviced (e.g. when called 
+ * with interrupts disabled) is accounted for using TOV2.
+ * 
+ * */
+static uint8_t sample(uint32_t *count, uint8_t *high)
+{
+    uint8_t seq;
+    uint8_t timer;
+    bool overflow;
+    
+    wake_sync();
+    
+    do{
+        
+        seq = sequence;
+        
+        *count = time;
+        *high = time_high;
+        
+        overflow = ((TIFR2 & _BV(TOV2)) > 0U);
+        
+        timer = TCNT2;
+        
+        if(overflow || (((TIFR2 & _BV(TOV2)) > 0U) && (timer < (UINT8_MAX>>1U)))){
+            
+            (*count)++;
+            
+            if(*count == 0U){
+                
+                (*high)++;
+            }
         }
+    }
+    while(seq != sequence);
+    
+    return timer;
+}
+
+/* latest value in [timeout, timeout + slack] with the most trailing zeros
+ * 
+ * Timers with overlapping windows tend to land on the same tick.
+ * 
+ * */
+static uint32_t align(uint32_t timeout, uint32_t slack)
+{
+    uint32_t retval = timeout + slack;
+    uint32_t diff;
+    
+    if(retval < timeout){
         
-        while((ASSR & _BV(OCR2AUB)) > 0);
+        /* window wraps through zero */
+        retval = 0U;
+    }
+    else if(slack > 0U){
+        
+        diff = retval ^ timeout;
+        
+        /* clear the bits below the highest bit that differs */
+        while((diff & (diff - 1U)) > 0U){
+            
+            diff &= diff - 1U;
+        }
         
-        OCR2A = TCNT2 + diff;
+        retval &= ~(diff - 1U);
     }
+    
+    return retval;
 }
+
+static void timer_link(volatile struct timer_event *volatile *head, volatile struct timer_event *self)
+{
+    self->next = *head;
+    self->prev = head;
     
-/* static functions ***************************************************/
+    if(self->next != NULL){
         
-static int32_t delta(uint32_t timeout, uint32_t time)
+        self->next->prev = &self->next;
+    }
+    
+    *head = self;
+}
+
+static void timer_unlink(volatile struct timer_event *self)
+{    
+    /* the link must point back to self if self is in a queue */
+    if((self->prev != NULL) && (*self->prev == self)){
+        
+        *self->prev = self->next;
+        
+        if(self->next != NULL){
+            
+            self->next->prev = self->prev;
+        }
+        
+        self->next = NULL;
+        self->prev = NULL;
+    }
+}
+
+static bool timer_already_linked(volatile struct timer_event *self)
+{    
+    return ((self->prev != NULL) && (*self->prev == self));
+}
+
+static void timer_arm(volatile struct timer_event *self, uint32_t interval, timer_handle_fn handler, bool once, bool deferred)
 {
-    return (int32_t)((timeout >= time) ? (timeout - time) : (UINT32_MAX - time + timeout));
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE){            
+
+        uint32_t time = timer_get_time();
+
+        assert(!timer_already_linked(self));
+        
+        self->timeout = time + interval;
+        self->expiry = align(self->timeout, self->slack);
+        self->interval = interval;
+        self->once = once;
+        self->handler = handler;
+        self->deferred = deferred;
+        
+        queue_insert(self, time);
+        
+        /* let the compare interrupt work out the next deadline */
+        compare_set(2);
+    }
 }
 
-static void timer_link(volatile struct timer_event **head, uint32_t time, volatile struct timer_event *self, uint32_t interval, timer_handle_fn handler)
+/* program OCR2A for the deadline diff ticks away
+ * 
+ * Deadlines beyond one TC2 period are left to the next compare at
+ * the current OCR2A. A deadline is never set closer than 2 ticks
+ * since TCNT2 may advance while the asynchronous write completes.
+ * 
+ * */
+static void compare_set(int32_t diff)
 {
-    volatile struct timer_event *ptr = *head;
-    volatile struct timer_event *prev = *head;
+    uint8_t value = OCR2A;
     
-    self->timeout = time + interval;
-    self->handler = handler;
-    self->next = NULL;
+    if(diff < 0xff){
+        
+        if(diff < 2){
+            
+            diff = 2;
+        }
+        
+        value = TCNT2 + (uint8_t)diff;
+    }
     
-    if(ptr == NULL){
+    while((ASSR & _BV(OCR2AUB)) > 0);
     
-        *head = self;        
+    OCR2A = value;
+}
+
+/* after a power-save wakeup TCNT2 reads the value from before sleep
+ * until a TOSC1 cycle has passed, a write to an asynchronous register
+ * followed by waiting on its busy flag guarantees that it has */
+static void wake_sync(void)
+{
+    if(sleeping){
+        
+        TCCR2A = TCCR2A;
+        while((ASSR & _BV(TCR2AUB)) > 0);
+        
+        sleeping = false;
+    }
+}
+
+static bool timer_queued(volatile struct timer_event *self)
+{
+    return ((self->ready != NULL) || (ready_tail == self));
+}
+
+static void timer_dequeue(volatile struct timer_event *self)
+{
+    if(ready_head == self){
+        
+        ready_head = self->ready;
     }
     else{
-    
-        while(ptr != NULL){
+        
+        volatile struct timer_event *ptr = ready_head;
+        
+        while((ptr != NULL) && (ptr->ready != self)){
             
-            int32_t diff = delta(ptr->timeout, time);
-
-            if((diff > 0) && (interval < diff)){
+            ptr = ptr->ready;
+        }
+        
+        /* not in the ready queue */
+        if(ptr != NULL){
+        
+            ptr->ready = self->ready;
             
-                self->next = ptr;
+            if(ready_tail == self){
                 
-                if(prev == ptr){
+                ready_tail = ptr;
+            }
+        }
+    }
+    
+    if(ready_head == NULL){
+        
+        ready_tail = NULL;
+    }
+    
+    self->ready = NULL;
+}
+
+static void expire(volatile struct timer_event *self, uint32_t time)
+{
+    /* re-arm from the deadline so that latency does not accumulate */
+    if(!self->once){
+        
+        self->timeout += self->interval;
+        self->expiry = align(self->timeout, self->slack);
+        queue_insert(self, time);
+    }
+    
+    if(self->deferred){
+        
+        if(!timer_queued(self)){
+            
+            if(ready_tail == NULL){
                 
-                    *head = self;
-                }
-                else{
-                    
-                    prev->next = self;
-                }
+                ready_head = self;
+            }
+            else{
                 
-                break;
+                ready_tail->ready = self;
             }
             
-            prev = ptr;
-            ptr = ptr->next;
+            ready_tail = self;
         }
     }
+    else{
+        
+        call(self);
+    }
 }
 
-static void timer_unlink(volatile struct timer_event **head, volatile struct timer_event *self)
-{    
-    volatile struct timer_event *ptr = *head;
-    volatile struct timer_event *prev = *head;
-            
-    while(ptr != NULL){
+static void call(volatile struct timer_event *self)
+{
+#ifdef TIMER_PROFILE
+    struct timer_profile *profile = self->profile;
+    uint32_t start = counter_get_time();
+#endif
+
+    self->handler(self);
+    
+#ifdef TIMER_PROFILE
+    if(profile != NULL){
+        
+        uint32_t exec = counter_get_time() - start;
         
-        if(ptr == self){
+        ATOMIC_BLOCK(ATOMIC_RESTORESTATE){
             
-            if(prev == ptr){
+            if((profile->exec_count == 0U) || (exec < profile->exec_min)){
                 
-                *head = ptr->next;
+                profile->exec_min = exec;
             }
-            else{
+            
+            if(exec > profile->exec_max){
+                
+                profile->exec_max = exec;
+            }
+            
+            if(profile->exec[bucket(exec)] < UINT16_MAX){
                 
-                prev->next = ptr->next;
+                profile->exec[bucket(exec)]++;
             }
+            
+            profile->exec_count++;
         }
+    }
+#endif
+}
+
+#ifdef TIMER_PROFILE
+
+/* 0 for 0, n for [2^(n-1), 2^n), saturating at the last bucket */
+static uint8_t bucket(uint32_t value)
+{
+    uint8_t retval = 0U;
+    
+    while((value > 0U) && (retval < (TIMER_PROFILE_BUCKETS - 1U))){
         
-        prev = ptr;
-        ptr = ptr->next;
+        value >>= 1U;
+        retval++;
     }
+    
+    return retval;
 }
 
-static int32_t timer_process(volatile struct timer_event **head, uint32_t time)
-{    
-    int32_t diff = 0xffU;
+/* lateness in counter ticks
+ * 
+ * Whole timer ticks between the deadline and the compare interrupt 
+ * are converted to counter ticks, and the time from entering the 
+ * interrupt to expiring this timer (e.g. behind other handlers 
+ * on the same tick) is measured with the counter directly.
+ * 
+ * */
+static void profile_late(volatile struct timer_event *self, uint32_t time)
+{
+    struct timer_profile *profile = self->profile;
     
-    volatile struct timer_event *ptr = *head;
+    if(profile != NULL){
+        
+        int32_t diff = delta(time, self->expiry);
+        uint32_t late = counter_get_time() - compare_entry;
+        
+        if(diff > 0){
+            
+            late += (uint32_t)(((uint64_t)diff * counter_ticks_per_second()) / TIMER_TICKS_PER_SECOND);
+        }
+        
+        if((profile->count == 0U) || (late < profile->late_min)){
+            
+            profile->late_min = late;
+        }
+        
+        if(late > profile->late_max){
+            
+            profile->late_max = late;
+        }
+        
+        if(profile->late[bucket(late)] < UINT16_MAX){
+            
+            profile->late[bucket(late)]++;
+        }
+        
+        profile->count++;
+    }
+}
+
+#endif
+
+#ifdef TIMER_WHEEL
+
+static void queue_init(uint32_t time)
+{
+    uint8_t level;
+    uint8_t slot;
     
-    while(ptr != NULL){
+    for(level=0U; level < TIMER_WHEEL_LEVELS; level++){
+        
+        for(slot=0U; slot < WHEEL_SLOTS; slot++){
             
-        if((diff = delta(ptr->timeout, time)) <= 0){
+            wheel[level][slot] = NULL;
+        }
+    }
+    
+    wheel_count = 0U;
+    wheel_time = time;
+}
+
+static void queue_insert(volatile struct timer_event *self, uint32_t time)
+{
+    /* nothing to catch up on when empty */
+    if(wheel_count == 0U){
+        
+        wheel_time = time;
+    }
+    
+    wheel_count++;
+    wheel_insert(self);
+}
+
+static void queue_remove(volatile struct timer_event *self)
+{
+    if(timer_already_linked(self)){
+        
+        timer_unlink(self);
+        wheel_count--;
+    }
+}
+
+static void queue_process(uint32_t time)
+{
+    while((int32_t)(time - wheel_time) >= 0){
+        
+        wheel_tick(time);
+    }
+}
+
+static int32_t queue_next(uint32_t time)
+{
+    return (wheel_count > 0U) ? (wheel_next() + (int32_t)(wheel_time - time)) : INT32_MAX;
+}
+
+static void wheel_insert(volatile struct timer_event *self)
+{
+    int32_t diff = (int32_t)(self->expiry - wheel_time);
+    uint32_t timeout = self->expiry;
+    uint8_t level;
+    
+    if(diff < 0){
+        
+        /* overdue: process on the next tick */
+        timeout = wheel_time;
+        level = 0U;
+    }
+    else{
+        
+        for(level=0U; level < (TIMER_WHEEL_LEVELS - 1U); level++){
             
-            *head = ptr->next;            
-            ptr->handler(ptr);
-            ptr = *head;
-            diff = 0xffU;
+            if((uint32_t)diff < (1UL << ((level + 1U) * TIMER_WHEEL_BITS))){
+                
+                break;
+            }
         }
-        else{
+        
+        /* beyond the horizon: park at the horizon and cascade again later */
+        if((uint32_t)diff >= (1UL << (TIMER_WHEEL_LEVELS * TIMER_WHEEL_BITS))){
             
-            break;
+            timeout = wheel_time + ((1UL << (TIMER_WHEEL_LEVELS * TIMER_WHEEL_BITS)) - 1UL);
         }
     }
     
-    return diff;
+    timer_link(&wheel[level][(timeout >> (level * TIMER_WHEEL_BITS)) & WHEEL_MASK], self);
 }
 
-static bool timer_already_linked(volatile struct timer_event *head, volatile struct timer_event *self)
-{    
-    volatile struct timer_event *ptr = head;
-    bool retval = false;
+static void wheel_cascade(uint8_t level, uint8_t slot)
+{
+    volatile struct timer_event *ptr = wheel[level][slot];
+    
+    wheel[level][slot] = NULL;
     
     while(ptr != NULL){
         
-        if(ptr == self){
+        volatile struct timer_event *next = ptr->next;
+        
+        ptr->prev = NULL;
+        wheel_insert(ptr);
+        
+        ptr = next;
+    }
+}
+
+static void wheel_tick(uint32_t time)
+{
+    volatile struct timer_event *volatile expired;
+    uint8_t level;
+    uint8_t slot = wheel_time & WHEEL_MASK;
+    
+#ifndef TIMER_PROFILE
+    (void)time;
+#endif
+    
+    /* move the next span of each level down */
+    for(level=1U; (slot == 0U) && (level < TIMER_WHEEL_LEVELS); level++){
+        
+        slot = (wheel_time >> (level * TIMER_WHEEL_BITS)) & WHEEL_MASK;
+        wheel_cascade(level, slot);
+    }
+    
+    /* detach this tick so that handlers may set timers */
+    expired = NULL;
+    slot = wheel_time & WHEEL_MASK;
+    
+    if(wheel[0U][slot] != NULL){
+        
+        expired = wheel[0U][slot];
+        expired->prev = &expired;
+        wheel[0U][slot] = NULL;
+    }
+    
+    wheel_time++;
+    
+    while(expired != NULL){
+        
+        volatile struct timer_event *ptr = expired;
+        
+        timer_unlink(ptr);
+        
+        /* parked at the horizon */
+        if((int32_t)(ptr->expiry - wheel_time) >= 0){
             
-            retval = true;
-            break;
+            wheel_insert(ptr);
         }
         else{
             
-            ptr = ptr->next;
+            wheel_count--;
+            
+#ifdef TIMER_PROFILE
+            /* relative to the interrupt time rather than wheel_time 
+             * (one tick ahead, or behind while catching up) so 
+             * that lateness is the same as with the list backend */
+            profile_late(ptr, time);
+#endif
+            
+            expire(ptr, wheel_time);
+        }
+    }
+}
+
+static int32_t wheel_next(void)
+{
+    int32_t retval = 0xff;
+    bool occupied = false;
+    uint32_t base;
+    uint8_t level;
+    uint8_t slot;
+    uint8_t k;
+    
+    /* first occupied tick in the lowest level */
+    for(k=0U; k < WHEEL_SLOTS; k++){
+        
+        if(wheel[0U][(wheel_time + k) & WHEEL_MASK] != NULL){
+            
+            retval = k;
+            break;
+        }
+    }
+    
+    /* first occupied span in the next level */
+    if(TIMER_WHEEL_LEVELS > 1U){
+        
+        base = (wheel_time + WHEEL_MASK) >> TIMER_WHEEL_BITS;
+        
+        for(k=0U; k < WHEEL_SLOTS; k++){
+            
+            int32_t diff = (int32_t)(((base + k) << TIMER_WHEEL_BITS) - wheel_time);
+            
+            if(diff >= retval){
+                
+                break;
+            }
+            
+            if(wheel[1U][(base + k) & WHEEL_MASK] != NULL){
+                
+                retval = diff;
+                break;
+            }
+        }
+    }
+    
+    /* higher levels cascade when the next level wraps */
+    for(level=2U; level < TIMER_WHEEL_LEVELS; level++){
+        
+        for(slot=0U; slot < WHEEL_SLOTS; slot++){
+            
+            if(wheel[level][slot] != NULL){
+                
+                occupied = true;
+                break;
+            }
+        }
+    }
+    
+    if(occupied){
+        
+        uint32_t span = 1UL << (2U * TIMER_WHEEL_BITS);
+        int32_t diff = (int32_t)((((wheel_time + span - 1U) / span) * span) - wheel_time);
+        
+        if(diff < retval){
+            
+            retval = diff;
         }
     }
     
     return retval;
 }
+
+#else
+
+static void queue_init(uint32_t time)
+{
+    timers = NULL;
+}
+
+static void queue_insert(volatile struct timer_event *self, uint32_t time)
+{
+    volatile struct timer_event *volatile *link = &timers;
+    int32_t interval = delta(self->expiry, time);
+    
+    while(*link != NULL){
+        
+        int32_t diff = delta((*link)->expiry, time);
+
+        if((diff > 0) && (interval < diff)){
+        
+            break;
+        }
+        
+        link = &(*link)->next;
+    }
+    
+    timer_link(link, self);
+}
+
+static void queue_remove(volatile struct timer_event *self)
+{    
+    timer_unlink(self);
+}
+
+static void queue_process(uint32_t time)
+{    
+    while((timers != NULL) && (delta(timers->expiry, time) <= 0)){
+            
+        volatile struct timer_event *ptr = timers;
+        
+        timer_unlink(ptr);
+        
+#ifdef TIMER_PROFILE
+        profile_late(ptr, time);
+#endif
+        
+        expire(ptr, time);
+    }
+}
+
+static int32_t queue_next(uint32_t time)
+{
+    return (timers != NULL) ? delta(timers->expiry, time) : INT32_MAX;
+}
+
+#endif
@@ -44,7 +44,7 @@ static uint32_t f_cpu(void);
 static uint16_t setting_from_baud(uint32_t baud, bool x2);
 static uint32_t baud_from_setting(uint16_t setting, bool x2);
 static bool use_2x(uint32_t ideal, uint16_t single_setting, uint16_t double_setting);
-static uint32_t delta(uint16_t a, uint16_t b);
+static uint32_t delta(uint32_t a, uint32_t b);
 static void dummy_handler(void);
 
 /* functions **********************************************************/
@@ -171,7 +171,7 @@ static uint32_t baud_from_setting(uint16_t setting, bool x2)
     return f_cpu() / ((x2 ? 8UL : 16UL) * (setting + 1U));
 }
 
-static uint32_t delta(uint16_t a, uint16_t b)
+static uint32_t delta(uint32_t a, uint32_t b)
 {
     return (a > b) ? (a - b) : (b - a);    
 }